@@ -0,0 +1,234 @@
+﻿// AsyncGameWriter.h : Appends finished games to an output file from a dedicated writer thread.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "PlyRow.h"
+#include "ResumeManifest.h"
+#include "Stats.h"
+
+// Games are queued whole (a bounded queue, so the analyzers block instead of piling up rows)
+// and encoded by the derived class on the writer thread, which buffers them and calls writeAll().
+// Every `syncEveryGames` games, and on checkpoint() and close(), pending output is written and fsynced,
+// and only then are the games that made it to disk recorded in the resume manifest, if there is one.
+// Derived classes must call close() in their own destructor, while their hooks can still run.
+class AsyncGameWriter {
+private:
+    struct Item {
+        GameRows game;
+        bool checkpoint = false;
+    };
+
+    std::deque<Item> queue;
+    size_t queueCapacity = 64;
+    size_t syncEveryGames = 0;
+    std::mutex mutex;
+    std::condition_variable notEmpty;
+    std::condition_variable notFull;
+    std::condition_variable synced;
+    uint64_t checkpointsRequested = 0;
+    uint64_t checkpointsDone = 0;
+    bool closing = false;
+    std::atomic<bool> failed = false;
+    std::thread writer;
+    size_t gamesSinceSync = 0;
+    ResumeManifest* manifest = nullptr;
+    std::vector<std::string> unsyncedGames;
+    std::atomic<uint64_t> fileSize = 0;
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+#else
+    int fd = -1;
+#endif
+
+    void sync() {
+        PipelineStats::Timer timer(pipelineStats, Stage::Sync);
+        flushPending();
+#ifdef _WIN32
+        bool synced = FlushFileBuffers(file) != 0;
+#else
+        bool synced = ::fsync(fd) == 0;
+#endif
+        if (manifest && !unsyncedGames.empty() && synced && !failed) {
+            manifest->commit(unsyncedGames, fileSize);
+        }
+        unsyncedGames.clear();
+        gamesSinceSync = 0;
+    }
+
+    void run() {
+        while (true) {
+            Item item;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                notEmpty.wait(lock, [&] { return !queue.empty() || closing; });
+                if (queue.empty()) break;
+                item = std::move(queue.front());
+                queue.pop_front();
+            }
+            notFull.notify_one();
+
+            if (item.checkpoint) {
+                sync();
+                std::lock_guard<std::mutex> lock(mutex);
+                checkpointsDone++;
+                synced.notify_all();
+                continue;
+            }
+
+            {
+                PipelineStats::Timer timer(pipelineStats, Stage::Output);
+                writeGame(item.game);
+            }
+            unsyncedGames.push_back(std::move(item.game.gameId));
+            if (syncEveryGames > 0 && ++gamesSinceSync >= syncEveryGames) {
+                sync();
+            }
+        }
+        sync();
+    }
+
+protected:
+    // Called on the writer thread once the file is open; `existingSize` is what it already held.
+    virtual void begin(uint64_t existingSize) = 0;
+
+    // Encodes one game, writing it out whenever enough has been buffered.
+    virtual void writeGame(const GameRows& game) = 0;
+
+    // Writes out everything still buffered; called before every fsync.
+    virtual void flushPending() = 0;
+
+    // Appends raw bytes to the file. A failure is reported once and drops all later output.
+    void writeAll(const char* data, size_t size) {
+        if (failed) return;
+        fileSize += size;
+#ifdef _WIN32
+        while (size > 0) {
+            DWORD chunk = static_cast<DWORD>(std::min<size_t>(size, 1u << 30));
+            DWORD written = 0;
+            if (!WriteFile(file, data, chunk, &written, nullptr)) break;
+            data += written;
+            size -= written;
+        }
+#else
+        while (size > 0) {
+            ssize_t written = ::write(fd, data, size);
+            if (written < 0) {
+                if (errno == EINTR) continue;
+                break;
+            }
+            data += written;
+            size -= static_cast<size_t>(written);
+        }
+#endif
+        if (size > 0) {
+            failed = true;
+            std::cerr << "Error: Could not write to the output file" << std::endl;
+        }
+    }
+
+public:
+    AsyncGameWriter() = default;
+    AsyncGameWriter(const AsyncGameWriter&) = delete;
+    AsyncGameWriter& operator=(const AsyncGameWriter&) = delete;
+
+    virtual ~AsyncGameWriter() {
+        close();
+    }
+
+    // Opens `path` for appending and starts the writer thread. `syncEveryGames` = 0 only syncs at checkpoints.
+    // Synced games are recorded in `manifest` when given.
+    bool open(const std::string& path, size_t syncEveryGames = 0, ResumeManifest* manifest = nullptr, size_t queueCapacity = 64) {
+        close();
+        uint64_t existingSize = 0;
+#ifdef _WIN32
+        file = CreateFileA(path.c_str(), FILE_APPEND_DATA, FILE_SHARE_READ, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) return false;
+        LARGE_INTEGER size;
+        if (GetFileSizeEx(file, &size)) existingSize = static_cast<uint64_t>(size.QuadPart);
+#else
+        fd = ::open(path.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+        if (fd < 0) return false;
+        off_t size = ::lseek(fd, 0, SEEK_END);
+        if (size > 0) existingSize = static_cast<uint64_t>(size);
+#endif
+        this->syncEveryGames = syncEveryGames;
+        this->manifest = manifest;
+        unsyncedGames.clear();
+        fileSize = existingSize;
+        this->queueCapacity = std::max<size_t>(queueCapacity, 1);
+        gamesSinceSync = 0;
+        closing = false;
+        failed = false;
+        begin(existingSize);
+        writer = std::thread(&AsyncGameWriter::run, this);
+        return true;
+    }
+
+    bool isOpen() const {
+        return writer.joinable();
+    }
+
+    // Size of the output including everything written so far; after checkpoint() this is what is on disk.
+    uint64_t size() const {
+        return fileSize;
+    }
+
+    // False once a write has failed; the rows from then on are dropped.
+    bool ok() const {
+        return !failed;
+    }
+
+    // Queues a finished game, waiting while the queue is full.
+    void submit(GameRows game) {
+        std::unique_lock<std::mutex> lock(mutex);
+        notFull.wait(lock, [&] { return queue.size() < queueCapacity; });
+        queue.push_back(Item{ std::move(game), false });
+        notEmpty.notify_one();
+    }
+
+    // Blocks until every game submitted so far is written and synced to disk.
+    void checkpoint() {
+        std::unique_lock<std::mutex> lock(mutex);
+        uint64_t ticket = ++checkpointsRequested;
+        queue.push_back(Item{ GameRows(), true });
+        notEmpty.notify_one();
+        synced.wait(lock, [&] { return checkpointsDone >= ticket; });
+    }
+
+    // Writes out everything still queued, syncs and closes the file.
+    void close() {
+        if (writer.joinable()) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                closing = true;
+            }
+            notEmpty.notify_one();
+            writer.join();
+        }
+#ifdef _WIN32
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+        file = INVALID_HANDLE_VALUE;
+#else
+        if (fd >= 0) ::close(fd);
+        fd = -1;
+#endif
+    }
+};
@@ -0,0 +1,1342 @@
+﻿// Benchmark.cpp : Measures the analyzer's own per-ply work on the bundled game file.
+// Apart from the runs against MockEngine (engine perft counts, the event loop and end to end) no engine
+// is started; the numbers are what we add on top of the engine's search time.
+//
+// Usage: CMakeProject3Bench [--check] [--json PATH] [--engine PATH] [game file]
+// The tables go to stdout; --json also writes every result as {"name", "value", "unit"} for
+// comparing runs between releases. --check runs only the benchmarks that also check results (parsing,
+// hashing, make/unmake, attacks, perft, search output, the columnar round trip, engine move counts);
+// ctest runs it that way. The exit status is 1 if any check failed.
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <map>
+#include <filesystem>
+#include <random>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#include "GameAnalyzer.h"
+#include "ColumnarReader.h"
+
+#ifndef BENCH_DATA_FILE
+#define BENCH_DATA_FILE "game_information0.json"
+#endif
+#ifndef BENCH_ENGINE
+#define BENCH_ENGINE "MockEngine"
+#endif
+
+using BenchClock = std::chrono::steady_clock;
+
+// Heap allocations made by the whole program, so benchParse can count what parsing a file costs. Every
+// form of operator new and delete is replaced, each pair on std::malloc / std::aligned_alloc and std::free.
+// They are kept out of line: inlined into a caller, GCC pairs the free() with the new expression and warns.
+static std::atomic<size_t> allocationCount{ 0 };
+
+[[gnu::noinline]] static void* countedAllocation(size_t size, size_t alignment) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    if (size == 0) size = 1;
+    if (alignment <= alignof(std::max_align_t)) return std::malloc(size);
+    // aligned_alloc wants the size to be a multiple of the alignment
+    return std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+}
+
+[[gnu::noinline]] static void countedFree(void* memory) noexcept {
+    std::free(memory);
+}
+
+static void* countedNew(size_t size, size_t alignment) {
+    if (void* memory = countedAllocation(size, alignment)) return memory;
+    throw std::bad_alloc();
+}
+
+void* operator new(size_t size) { return countedNew(size, 0); }
+void* operator new[](size_t size) { return countedNew(size, 0); }
+void* operator new(size_t size, std::align_val_t alignment) { return countedNew(size, static_cast<size_t>(alignment)); }
+void* operator new[](size_t size, std::align_val_t alignment) { return countedNew(size, static_cast<size_t>(alignment)); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return countedAllocation(size, 0); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return countedAllocation(size, 0); }
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return countedAllocation(size, static_cast<size_t>(alignment));
+}
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return countedAllocation(size, static_cast<size_t>(alignment));
+}
+
+void operator delete(void* memory) noexcept { countedFree(memory); }
+void operator delete[](void* memory) noexcept { countedFree(memory); }
+void operator delete(void* memory, size_t) noexcept { countedFree(memory); }
+void operator delete[](void* memory, size_t) noexcept { countedFree(memory); }
+void operator delete(void* memory, std::align_val_t) noexcept { countedFree(memory); }
+void operator delete[](void* memory, std::align_val_t) noexcept { countedFree(memory); }
+void operator delete(void* memory, size_t, std::align_val_t) noexcept { countedFree(memory); }
+void operator delete[](void* memory, size_t, std::align_val_t) noexcept { countedFree(memory); }
+void operator delete(void* memory, const std::nothrow_t&) noexcept { countedFree(memory); }
+void operator delete[](void* memory, const std::nothrow_t&) noexcept { countedFree(memory); }
+void operator delete(void* memory, std::align_val_t, const std::nothrow_t&) noexcept { countedFree(memory); }
+void operator delete[](void* memory, std::align_val_t, const std::nothrow_t&) noexcept { countedFree(memory); }
+
+// Every number the benchmarks print that is worth tracking between releases.
+class BenchReport {
+private:
+    struct Result {
+        std::string name;
+        double value;
+        std::string unit;
+    };
+    std::vector<Result> results;
+
+    static std::string quoted(const std::string& text) {
+        std::string out = "\"";
+        for (char c : text) {
+            if (c == '"' || c == '\\') out += '\\';
+            out += c;
+        }
+        return out + "\"";
+    }
+
+public:
+    void add(const std::string& name, double value, const std::string& unit) {
+        results.push_back({ name, value, unit });
+    }
+
+    bool writeJson(const std::string& path, const std::string& dataFile) const {
+        std::ofstream out(path);
+        out << "{\n  \"benchmark\": \"CMakeProject3Bench\",\n  \"dataFile\": " << quoted(dataFile) << ",\n  \"results\": [\n";
+        out << std::setprecision(10);
+        for (size_t i = 0; i < results.size(); i++) {
+            out << "    { \"name\": " << quoted(results[i].name) << ", \"value\": " << results[i].value
+                << ", \"unit\": " << quoted(results[i].unit) << " }" << (i + 1 < results.size() ? ",\n" : "\n");
+        }
+        out << "  ]\n}\n";
+        return static_cast<bool>(out);
+    }
+};
+
+static BenchReport report;
+
+static double nanosecondsSince(BenchClock::time_point start) {
+    return std::chrono::duration<double, std::nano>(BenchClock::now() - start).count();
+}
+
+// Every position reached in `games`, in order, for the benchmarks that work on single positions.
+static std::vector<ChessPosition> replayPositions(const std::vector<GameData>& games) {
+    std::vector<ChessPosition> positions;
+    for (const GameData& game : games) {
+        ChessPosition position;
+        for (Move move : game.moves) {
+            if (!position.makeMove(move)) break;
+            positions.push_back(position);
+        }
+    }
+    return positions;
+}
+
+// Number of moves listed after "moves" in a position command.
+static size_t countListedMoves(const std::string& command) {
+    size_t at = command.find(" moves");
+    return at == std::string::npos ? 0 : std::count(command.begin() + at + 6, command.end(), ' ');
+}
+
+// The game file parser as it was before the memory-mapped one: reads the file line by line into one
+// string and cuts it up with find/substr and std::stringstream. Kept as the baseline for benchParse,
+// along with the layout games had then: a string per move and a vector per timestamp array.
+struct LegacyGameData {
+    std::string gameId;
+    std::vector<std::string> moves;
+    std::vector<int> whiteTimestamps;
+    std::vector<int> blackTimestamps;
+};
+
+static std::string legacyTrim(const std::string& str) {
+    size_t first = str.find_first_not_of(" \t\n\r\"");
+    if (first == std::string::npos) return "";
+    size_t last = str.find_last_not_of(" \t\n\r\"");
+    return str.substr(first, (last - first + 1));
+}
+
+static std::vector<std::string> legacySplit(const std::string& str, char delimiter) {
+    std::vector<std::string> tokens;
+    std::stringstream ss(str);
+    std::string token;
+    while (std::getline(ss, token, delimiter)) {
+        tokens.push_back(legacyTrim(token));
+    }
+    return tokens;
+}
+
+static std::vector<int> legacyParseTimestamps(const std::string& arrayStr) {
+    std::vector<int> timestamps;
+    std::string cleaned = arrayStr;
+
+    // Remove brackets and quotes
+    size_t start = cleaned.find('[');
+    size_t end = cleaned.find(']');
+    if (start != std::string::npos && end != std::string::npos) {
+        cleaned = cleaned.substr(start + 1, end - start - 1);
+    }
+
+    auto tokens = legacySplit(cleaned, ',');
+    for (const auto& token : tokens) {
+        if (!token.empty()) {
+            timestamps.push_back(std::stoi(token));
+        }
+    }
+    return timestamps;
+}
+
+static std::vector<std::string> legacyParseMoves(const std::string& arrayStr) {
+    std::vector<std::string> moves;
+    std::string cleaned = arrayStr;
+
+    // Remove brackets
+    size_t start = cleaned.find('[');
+    size_t end = cleaned.find(']');
+    if (start != std::string::npos && end != std::string::npos) {
+        cleaned = cleaned.substr(start + 1, end - start - 1);
+    }
+
+    auto tokens = legacySplit(cleaned, ',');
+    for (const auto& token : tokens) {
+        if (!token.empty()) {
+            moves.push_back(token);
+        }
+    }
+    return moves;
+}
+
+static std::vector<LegacyGameData> legacyParseGameFile(const std::string& filename) {
+    std::vector<LegacyGameData> games;
+    std::ifstream file(filename);
+
+    if (!file.is_open()) {
+        std::cout << "Error: Could not open " << filename << std::endl;
+        return games;
+    }
+
+    std::string line, content;
+    while (std::getline(file, line)) {
+        content += line + "\n";
+    }
+    file.close();
+
+    // Simple JSON parsing for the specific structure
+    size_t pos = 0;
+    while ((pos = content.find('"', pos)) != std::string::npos) {
+        size_t idStart = pos + 1;
+        size_t idEnd = content.find('"', idStart);
+        if (idEnd == std::string::npos) break;
+
+        std::string gameId = content.substr(idStart, idEnd - idStart);
+        if (gameId.length() < 10) { // Skip short strings like field names
+            pos = idEnd + 1;
+            continue;
+        }
+
+        LegacyGameData game;
+        game.gameId = gameId;
+
+        // Find the game data block
+        size_t blockStart = content.find('{', idEnd);
+        size_t blockEnd = content.find('}', blockStart);
+        if (blockStart == std::string::npos || blockEnd == std::string::npos) {
+            pos = idEnd + 1;
+            continue;
+        }
+
+        std::string gameBlock = content.substr(blockStart, blockEnd - blockStart + 1);
+
+        // Parse moveListArray
+        size_t movesPos = gameBlock.find("\"moveListArray\"");
+        if (movesPos != std::string::npos) {
+            size_t arrayStart = gameBlock.find('[', movesPos);
+            size_t arrayEnd = gameBlock.find(']', arrayStart);
+            if (arrayStart != std::string::npos && arrayEnd != std::string::npos) {
+                std::string movesArray = gameBlock.substr(arrayStart, arrayEnd - arrayStart + 1);
+                game.moves = legacyParseMoves(movesArray);
+            }
+        }
+
+        // Parse whiteMoveTimestampsArray
+        size_t whitePos = gameBlock.find("\"whiteMoveTimestampsArray\"");
+        if (whitePos != std::string::npos) {
+            size_t arrayStart = gameBlock.find('[', whitePos);
+            size_t arrayEnd = gameBlock.find(']', arrayStart);
+            if (arrayStart != std::string::npos && arrayEnd != std::string::npos) {
+                std::string timestampsArray = gameBlock.substr(arrayStart, arrayEnd - arrayStart + 1);
+                game.whiteTimestamps = legacyParseTimestamps(timestampsArray);
+            }
+        }
+
+        // Parse blackMoveTimestampsArray
+        size_t blackPos = gameBlock.find("\"blackMoveTimestampsArray\"");
+        if (blackPos != std::string::npos) {
+            size_t arrayStart = gameBlock.find('[', blackPos);
+            size_t arrayEnd = gameBlock.find(']', arrayStart);
+            if (arrayStart != std::string::npos && arrayEnd != std::string::npos) {
+                std::string timestampsArray = gameBlock.substr(arrayStart, arrayEnd - arrayStart + 1);
+                game.blackTimestamps = legacyParseTimestamps(timestampsArray);
+            }
+        }
+
+        if (!game.moves.empty()) {
+            games.push_back(game);
+        }
+
+        pos = blockEnd + 1;
+    }
+
+    return games;
+}
+
+// Check detection as it was before ChessPosition kept bitboards: a scan of all 64 squares for the
+// king and a square-by-square walk along every ray over the char board. Kept as the baseline for
+// benchAttacks and benchPerft.
+static std::pair<int, int> legacyFindKing(const ChessPosition& position, bool isWhite) {
+    char king = isWhite ? 'K' : 'k';
+    for (int rank = 0; rank < 8; rank++) {
+        for (int file = 0; file < 8; file++) {
+            if (position.pieceAt(rank, file) == king) {
+                return { rank, file };
+            }
+        }
+    }
+    return { -1, -1 }; // Should never happen in valid position
+}
+
+static bool legacyIsSquareAttacked(const ChessPosition& position, int rank, int file, bool byWhite) {
+    // Check for pawn attacks
+    int pawnDirection = byWhite ? 1 : -1;
+    int pawnRank = rank - pawnDirection;
+    char pawn = byWhite ? 'P' : 'p';
+
+    if (pawnRank >= 0 && pawnRank < 8) {
+        if (file > 0 && position.pieceAt(pawnRank, file - 1) == pawn) return true;
+        if (file < 7 && position.pieceAt(pawnRank, file + 1) == pawn) return true;
+    }
+
+    // Check for knight attacks
+    char knight = byWhite ? 'N' : 'n';
+    int knightMoves[8][2] = { {-2,-1},{-2,1},{-1,-2},{-1,2},{1,-2},{1,2},{2,-1},{2,1} };
+    for (int i = 0; i < 8; i++) {
+        int newRank = rank + knightMoves[i][0];
+        int newFile = file + knightMoves[i][1];
+        if (newRank >= 0 && newRank < 8 && newFile >= 0 && newFile < 8) {
+            if (position.pieceAt(newRank, newFile) == knight) return true;
+        }
+    }
+
+    // Check for bishop/queen diagonal attacks
+    char bishop = byWhite ? 'B' : 'b';
+    char queen = byWhite ? 'Q' : 'q';
+    int directions[4][2] = { {1,1},{1,-1},{-1,1},{-1,-1} };
+
+    for (int d = 0; d < 4; d++) {
+        for (int i = 1; i < 8; i++) {
+            int newRank = rank + directions[d][0] * i;
+            int newFile = file + directions[d][1] * i;
+
+            if (newRank < 0 || newRank >= 8 || newFile < 0 || newFile >= 8) break;
+
+            char piece = position.pieceAt(newRank, newFile);
+            if (piece != '.') {
+                if (piece == bishop || piece == queen) return true;
+                break; // Blocked by another piece
+            }
+        }
+    }
+
+    // Check for rook/queen straight attacks
+    char rook = byWhite ? 'R' : 'r';
+    int straightDirections[4][2] = { {1,0},{-1,0},{0,1},{0,-1} };
+
+    for (int d = 0; d < 4; d++) {
+        for (int i = 1; i < 8; i++) {
+            int newRank = rank + straightDirections[d][0] * i;
+            int newFile = file + straightDirections[d][1] * i;
+
+            if (newRank < 0 || newRank >= 8 || newFile < 0 || newFile >= 8) break;
+
+            char piece = position.pieceAt(newRank, newFile);
+            if (piece != '.') {
+                if (piece == rook || piece == queen) return true;
+                break; // Blocked by another piece
+            }
+        }
+    }
+
+    // Check for king attacks
+    char king = byWhite ? 'K' : 'k';
+    for (int dr = -1; dr <= 1; dr++) {
+        for (int df = -1; df <= 1; df++) {
+            if (dr == 0 && df == 0) continue;
+            int newRank = rank + dr;
+            int newFile = file + df;
+            if (newRank >= 0 && newRank < 8 && newFile >= 0 && newFile < 8) {
+                if (position.pieceAt(newRank, newFile) == king) return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+static bool legacyIsInCheck(const ChessPosition& position, bool isWhiteKing) {
+    auto kingPos = legacyFindKing(position, isWhiteKing);
+    if (kingPos.first == -1) return false; // No king found
+
+    return legacyIsSquareAttacked(position, kingPos.first, kingPos.second, !isWhiteKing);
+}
+
+// Heap memory held by games in the legacy layout, counting only the buffers strings and vectors
+// allocate (strings of up to 15 characters live in the string itself).
+static size_t legacyMemoryBytes(const std::vector<LegacyGameData>& games) {
+    auto stringBytes = [](const std::string& text) {
+        return text.capacity() > 15 ? text.capacity() + 1 : 0;
+    };
+    size_t bytes = games.capacity() * sizeof(LegacyGameData);
+    for (const LegacyGameData& game : games) {
+        bytes += stringBytes(game.gameId);
+        bytes += game.moves.capacity() * sizeof(std::string);
+        for (const std::string& move : game.moves) bytes += stringBytes(move);
+        bytes += (game.whiteTimestamps.capacity() + game.blackTimestamps.capacity()) * sizeof(int);
+    }
+    return bytes;
+}
+
+// Throughput, allocations and memory footprint of GameFileParser against the legacy parser on the
+// same file, and a check that both read the same games the same way. Returns false if they disagree.
+static bool benchParse(const std::string& dataFile) {
+    const int repetitions = 10;
+    std::ifstream sizeProbe(dataFile, std::ios::binary | std::ios::ate);
+    double megabytes = static_cast<double>(sizeProbe.tellg()) / (1024.0 * 1024.0);
+
+    std::vector<LegacyGameData> legacyGames;
+    GameArena mappedGames;
+    size_t allocationsBefore = allocationCount.load();
+    auto start = BenchClock::now();
+    for (int rep = 0; rep < repetitions; rep++) {
+        legacyGames = legacyParseGameFile(dataFile);
+    }
+    double legacySeconds = std::chrono::duration<double>(BenchClock::now() - start).count() / repetitions;
+    double legacyAllocations = static_cast<double>(allocationCount.load() - allocationsBefore) / repetitions;
+
+    allocationsBefore = allocationCount.load();
+    start = BenchClock::now();
+    for (int rep = 0; rep < repetitions; rep++) {
+        GameFileParser().parse(dataFile, mappedGames);
+    }
+    double mappedSeconds = std::chrono::duration<double>(BenchClock::now() - start).count() / repetitions;
+    double mappedAllocations = static_cast<double>(allocationCount.load() - allocationsBefore) / repetitions;
+
+    double legacyMegabytes = legacyMemoryBytes(legacyGames) / (1024.0 * 1024.0);
+    double arenaMegabytes = mappedGames.memoryBytes() / (1024.0 * 1024.0);
+
+    // The legacy parser drops games with ids shorter than ten characters and misreads the field
+    // names around null arrays as games, so only games both parsers found are compared.
+    std::map<std::string_view, const GameData*> mappedById;
+    for (const GameData& game : mappedGames.games()) mappedById[game.gameId] = &game;
+
+    size_t shared = 0;
+    size_t different = 0;
+    for (const LegacyGameData& game : legacyGames) {
+        auto it = mappedById.find(game.gameId);
+        if (it == mappedById.end()) continue;
+        const GameData& mapped = *it->second;
+        shared++;
+        bool sameMoves = std::equal(game.moves.begin(), game.moves.end(), mapped.moves.begin(), mapped.moves.end(),
+            [](const std::string& text, Move move) { return parseUciMove(text) == move; });
+        if (!sameMoves ||
+            !std::equal(game.whiteTimestamps.begin(), game.whiteTimestamps.end(), mapped.whiteTimestamps.begin(), mapped.whiteTimestamps.end()) ||
+            !std::equal(game.blackTimestamps.begin(), game.blackTimestamps.end(), mapped.blackTimestamps.begin(), mapped.blackTimestamps.end())) {
+            different++;
+        }
+    }
+
+    std::cout << "parse " << dataFile << " (" << std::fixed << std::setprecision(2) << megabytes << " MB)\n" << std::setprecision(1)
+        << "  legacy parser   " << std::setw(8) << megabytes / legacySeconds << " MB/s, " << legacyGames.size() << " games, "
+        << std::setprecision(0) << legacyAllocations << " allocations, " << std::setprecision(2) << legacyMegabytes << " MB held\n" << std::setprecision(1)
+        << "  mapped parser   " << std::setw(8) << megabytes / mappedSeconds << " MB/s, " << mappedGames.size() << " games, "
+        << std::setprecision(0) << mappedAllocations << " allocations, " << std::setprecision(2) << arenaMegabytes << " MB held\n" << std::setprecision(1)
+        << "  games in both   " << std::setw(8) << shared << ", " << different << " different\n" << std::endl;
+
+    report.add("parse.legacy", megabytes / legacySeconds, "MB/s");
+    report.add("parse.mapped", megabytes / mappedSeconds, "MB/s");
+    report.add("parse.legacyAllocations", legacyAllocations, "allocations/file");
+    report.add("parse.mappedAllocations", mappedAllocations, "allocations/file");
+    report.add("parse.legacyMemory", legacyMegabytes, "MB");
+    report.add("parse.arenaMemory", arenaMegabytes, "MB");
+    report.add("parse.games", static_cast<double>(mappedGames.size()), "games");
+    report.add("parse.different", static_cast<double>(different), "games");
+    return different == 0;
+}
+
+// Per-ply cost of keeping the engine's position up to date, full replay vs incremental, grouped by
+// how far into the game the ply is. The moves column is how many moves the engine has to replay
+// to apply the command, which is what dominates on the engine side.
+static void benchPositionCommands(const std::vector<GameData>& games) {
+    const size_t bucketSize = 25;
+    const size_t bucketCount = 8; // the last bucket collects everything from ply 175 on
+    const int repetitions = 5;
+
+    struct Bucket {
+        double nanoseconds = 0;
+        double bytes = 0;
+        double movesReplayed = 0;
+        size_t plies = 0;
+    };
+
+    std::cout << "position command cost per ply (" << repetitions << " passes over " << games.size() << " games)\n";
+    std::cout << std::left << std::setw(12) << "plies"
+        << std::right << std::setw(14) << "replay ns" << std::setw(14) << "replay bytes" << std::setw(14) << "replay moves"
+        << std::setw(14) << "incr ns" << std::setw(14) << "incr bytes" << std::setw(14) << "incr moves" << "\n";
+
+    std::vector<Bucket> results[2];
+    for (int mode = 0; mode < 2; mode++) {
+        std::vector<Bucket>& buckets = results[mode];
+        buckets.assign(bucketCount, Bucket());
+        PositionCommand command(mode == 1);
+
+        for (int rep = 0; rep < repetitions; rep++) {
+            for (const GameData& game : games) {
+                ChessPosition position;
+                command.reset();
+                bool boardInSync = true;
+
+                for (size_t i = 0; i < game.moves.size(); i++) {
+                    auto start = BenchClock::now();
+                    bool autoQueen = position.isUnmarkedPromotion(game.moves[i]);
+                    boardInSync = position.makeMove(game.moves[i]) && boardInSync;
+                    const std::string& text = command.afterMove(game.moves[i], autoQueen, position, boardInSync);
+                    auto end = BenchClock::now();
+
+                    Bucket& bucket = buckets[std::min(i / bucketSize, bucketCount - 1)];
+                    bucket.nanoseconds += std::chrono::duration<double, std::nano>(end - start).count();
+                    bucket.bytes += text.size();
+                    bucket.movesReplayed += countListedMoves(text);
+                    bucket.plies++;
+                }
+            }
+        }
+    }
+
+    for (size_t b = 0; b < bucketCount; b++) {
+        std::string label = std::to_string(b * bucketSize + 1) + (b + 1 < bucketCount ? "-" + std::to_string((b + 1) * bucketSize) : "+");
+        std::cout << std::left << std::setw(12) << label << std::right << std::fixed << std::setprecision(1);
+        for (int mode = 0; mode < 2; mode++) {
+            const Bucket& bucket = results[mode][b];
+            double plies = bucket.plies ? static_cast<double>(bucket.plies) : 1.0;
+            std::cout << std::setw(14) << bucket.nanoseconds / plies << std::setw(14) << bucket.bytes / plies
+                << std::setw(14) << bucket.movesReplayed / plies;
+        }
+        std::cout << "\n";
+    }
+    std::cout << std::endl;
+
+    const char* modeNames[2] = { "replay", "incremental" };
+    for (int mode = 0; mode < 2; mode++) {
+        Bucket total;
+        for (const Bucket& bucket : results[mode]) {
+            total.nanoseconds += bucket.nanoseconds;
+            total.bytes += bucket.bytes;
+            total.movesReplayed += bucket.movesReplayed;
+            total.plies += bucket.plies;
+        }
+        double plies = total.plies ? static_cast<double>(total.plies) : 1.0;
+        std::string name = std::string("positionCommand.") + modeNames[mode];
+        report.add(name + ".time", total.nanoseconds / plies, "ns/ply");
+        report.add(name + ".bytes", total.bytes / plies, "bytes/ply");
+        report.add(name + ".moves", total.movesReplayed / plies, "moves/ply");
+    }
+}
+
+// Cost of ChessPosition::makeMove, which keeps the Zobrist hash up to date, next to the cost of
+// hashing the position from scratch. Also checks the incremental hash against the full one after
+// every move of every game; returns false on a mismatch.
+static bool benchMakeMove(const std::vector<GameData>& games) {
+    const int repetitions = 5;
+    size_t plies = 0;
+    size_t mismatches = 0;
+    size_t bitboardMismatches = 0;
+
+    for (const GameData& game : games) {
+        ChessPosition position;
+        for (Move move : game.moves) {
+            position.makeMove(move);
+            if (position.hash() != position.computeHash()) mismatches++;
+            if (!(position.bitboards() == position.computeBitboards())) bitboardMismatches++;
+            plies++;
+        }
+    }
+
+    uint64_t sink = 0;
+    auto start = BenchClock::now();
+    for (int rep = 0; rep < repetitions; rep++) {
+        for (const GameData& game : games) {
+            ChessPosition position;
+            for (Move move : game.moves) {
+                position.makeMove(move);
+            }
+            sink ^= position.hash();
+        }
+    }
+    double makeMoveNs = std::chrono::duration<double, std::nano>(BenchClock::now() - start).count() / (plies * repetitions);
+
+    start = BenchClock::now();
+    for (int rep = 0; rep < repetitions; rep++) {
+        for (const GameData& game : games) {
+            ChessPosition position;
+            for (Move move : game.moves) {
+                position.makeMove(move);
+                sink ^= position.computeHash();
+            }
+        }
+    }
+    double fullHashNs = std::chrono::duration<double, std::nano>(BenchClock::now() - start).count() / (plies * repetitions) - makeMoveNs;
+
+    std::cout << "makeMove over " << plies << " plies (" << repetitions << " passes)\n" << std::fixed << std::setprecision(1)
+        << "  makeMove with incremental hash  " << std::setw(8) << makeMoveNs << " ns/move\n"
+        << "  hash from scratch               " << std::setw(8) << fullHashNs << " ns/position\n"
+        << "  incremental hash mismatches     " << std::setw(8) << mismatches << "\n"
+        << "  incremental bitboard mismatches " << std::setw(8) << bitboardMismatches << "\n"
+        << "  (checksum " << std::hex << sink << std::dec << ")\n" << std::endl;
+
+    report.add("makeMove.time", makeMoveNs, "ns/move");
+    report.add("makeMove.fullHash", fullHashNs, "ns/position");
+    report.add("makeMove.hashMismatches", static_cast<double>(mismatches), "positions");
+    report.add("makeMove.bitboardMismatches", static_cast<double>(bitboardMismatches), "positions");
+    return mismatches == 0 && bitboardMismatches == 0;
+}
+
+// Random walks of legal moves from every position of the games, taken back one by one with unmakeMove.
+// Checks that every unmake restores the exact position, hash and bitboards included, and times
+// make + unmake against copying the position and making the move on the copy. Returns false on a mismatch.
+static bool benchMakeUnmake(const std::vector<ChessPosition>& positions) {
+    const int walkLength = 16;
+    std::mt19937_64 random(2024);
+    std::vector<ChessPosition> path;
+    size_t roundTrips = 0;
+    size_t mismatches = 0;
+
+    for (const ChessPosition& start : positions) {
+        ChessPosition position = start;
+        UndoInfo undo[walkLength];
+        path.clear();
+        for (int ply = 0; ply < walkLength; ply++) {
+            Move moves[ChessPosition::MaxMoves];
+            int count = position.generateLegalMoves(moves);
+            if (count == 0) break;
+            path.push_back(position);
+            if (!position.makeMove(moves[random() % count], undo[ply])) {
+                path.pop_back();
+                mismatches++;
+                break;
+            }
+            if (position.hash() != position.computeHash() || !(position.bitboards() == position.computeBitboards())) mismatches++;
+        }
+        for (size_t ply = path.size(); ply-- > 0;) {
+            position.unmakeMove(undo[ply]);
+            if (!(position == path[ply])) mismatches++;
+            roundTrips++;
+        }
+
+        // A rejected move (here one from an empty square) must leave the position and the undo record alone
+        UndoInfo untouched{};
+        undo[0] = untouched;
+        int empty = 0;
+        while (position.pieceAt(empty / 8, empty % 8) != '.') empty++;
+        if (position.makeMove(encodeMove(empty, empty ^ 1), undo[0]) || !(position == start) ||
+            std::memcmp(&untouched, &undo[0], sizeof(UndoInfo)) != 0) mismatches++;
+    }
+
+    // Timing: the first legal move of every position, both ways
+    const int repetitions = 20;
+    std::vector<Move> firstMoves;
+    std::vector<ChessPosition> movable;
+    for (const ChessPosition& position : positions) {
+        Move moves[ChessPosition::MaxMoves];
+        if (position.generateLegalMoves(moves) == 0) continue;
+        firstMoves.push_back(moves[0]);
+        movable.push_back(position);
+    }
+    size_t calls = movable.size() * repetitions;
+    if (calls == 0) calls = 1;
+
+    uint64_t sink = 0;
+    auto start = BenchClock::now();
+    for (int rep = 0; rep < repetitions; rep++) {
+        for (size_t i = 0; i < movable.size(); i++) {
+            UndoInfo undo;
+            if (!movable[i].makeMove(firstMoves[i], undo)) continue;
+            sink += movable[i].hash();
+            movable[i].unmakeMove(undo);
+        }
+    }
+    double makeUnmakeNs = nanosecondsSince(start) / calls;
+
+    start = BenchClock::now();
+    for (int rep = 0; rep < repetitions; rep++) {
+        for (size_t i = 0; i < movable.size(); i++) {
+            ChessPosition next = movable[i];
+            next.makeMove(firstMoves[i]);
+            sink += next.hash();
+        }
+    }
+    double copyMakeNs = nanosecondsSince(start) / calls;
+
+    std::cout << "make/unmake over " << positions.size() << " positions (walks of " << walkLength << ")\n" << std::fixed << std::setprecision(1)
+        << "  round trips                     " << std::setw(8) << roundTrips << "\n"
+        << "  mismatches                      " << std::setw(8) << mismatches << "\n"
+        << "  makeMove + unmakeMove           " << std::setw(8) << makeUnmakeNs << " ns/move\n"
+        << "  copy + makeMove                 " << std::setw(8) << copyMakeNs << " ns/move\n"
+        << "  (checksum " << std::hex << sink << std::dec << ")\n" << std::endl;
+
+    report.add("makeUnmake.time", makeUnmakeNs, "ns/move");
+    report.add("makeUnmake.copyMake", copyMakeNs, "ns/move");
+    report.add("makeUnmake.mismatches", static_cast<double>(mismatches), "round trips");
+    return mismatches == 0;
+}
+
+// Cost of the check and attack queries on every position of the games, against the legacy ray walk:
+// isInCheck for the side to move, and isSquareAttacked for every square by each side. Returns false
+// if the two ever disagree.
+static bool benchAttacks(const std::vector<ChessPosition>& positions) {
+    const int repetitions = 5;
+    uint64_t sink = 0;
+    size_t disagreements = 0;
+
+    for (const ChessPosition& position : positions) {
+        for (int square = 0; square < 64; square++) {
+            for (bool byWhite : { true, false }) {
+                if (position.isSquareAttacked(square / 8, square % 8, byWhite) !=
+                    legacyIsSquareAttacked(position, square / 8, square % 8, byWhite)) disagreements++;
+            }
+        }
+    }
+
+    auto timeInCheck = [&](auto&& inCheck) {
+        auto start = BenchClock::now();
+        for (int rep = 0; rep < repetitions; rep++) {
+            for (const ChessPosition& position : positions) {
+                sink += inCheck(position);
+            }
+        }
+        return nanosecondsSince(start) / (positions.size() * repetitions);
+    };
+    auto timeAttacked = [&](auto&& attacked) {
+        auto start = BenchClock::now();
+        for (const ChessPosition& position : positions) {
+            for (int square = 0; square < 64; square++) {
+                sink += attacked(position, square, true);
+                sink += attacked(position, square, false);
+            }
+        }
+        return nanosecondsSince(start) / (positions.size() * 128);
+    };
+
+    double inCheckNs = timeInCheck([](const ChessPosition& p) { return p.isInCheck(p.isWhiteToMove()); });
+    double legacyInCheckNs = timeInCheck([](const ChessPosition& p) { return legacyIsInCheck(p, p.isWhiteToMove()); });
+    double attackedNs = timeAttacked([](const ChessPosition& p, int sq, bool w) { return p.isSquareAttacked(sq / 8, sq % 8, w); });
+    double legacyAttackedNs = timeAttacked([](const ChessPosition& p, int sq, bool w) { return legacyIsSquareAttacked(p, sq / 8, sq % 8, w); });
+
+    std::cout << "attack queries over " << positions.size() << " positions\n" << std::fixed << std::setprecision(1)
+        << "  isInCheck                       " << std::setw(8) << inCheckNs << " ns/call (ray walk " << legacyInCheckNs << ")\n"
+        << "  isSquareAttacked                " << std::setw(8) << attackedNs << " ns/call (ray walk " << legacyAttackedNs << ")\n"
+        << "  disagreements                   " << std::setw(8) << disagreements << "\n"
+        << "  (checksum " << sink << ")\n" << std::endl;
+
+    report.add("attacks.isInCheck", inCheckNs, "ns/call");
+    report.add("attacks.isInCheck.rayWalk", legacyInCheckNs, "ns/call");
+    report.add("attacks.isSquareAttacked", attackedNs, "ns/call");
+    report.add("attacks.isSquareAttacked.rayWalk", legacyAttackedNs, "ns/call");
+    report.add("attacks.disagreements", static_cast<double>(disagreements), "queries");
+    return disagreements == 0;
+}
+
+// Perft (counting the leaves of the legal move tree) on standard positions with known counts, which
+// exercises makeMove, unmakeMove and legal move generation. A second walk over the same trees times isInCheck
+// against the legacy ray walk on every interior node. Returns false on a wrong count.
+static bool benchPerft() {
+    struct PerftCase {
+        const char* name;
+        const char* fen;
+        int depth;
+        uint64_t nodes;
+    };
+    const PerftCase cases[] = {
+        { "startpos", "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 4, 197281 },
+        { "kiwipete", "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", 3, 97862 },
+        { "endgame", "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", 4, 43238 },
+    };
+
+    // `visit` is called on every interior node.
+    auto perft = [](auto&& self, ChessPosition& position, int depth, auto&& visit) -> uint64_t {
+        Move moves[ChessPosition::MaxMoves];
+        int count = position.generateLegalMoves(moves);
+        if (depth <= 1) return count;
+
+        visit(position);
+        uint64_t nodes = 0;
+        UndoInfo undo;
+        for (int i = 0; i < count; i++) {
+            if (!position.makeMove(moves[i], undo)) continue;
+            nodes += self(self, position, depth - 1, visit);
+            position.unmakeMove(undo);
+        }
+        return nodes;
+    };
+
+    bool ok = true;
+    uint64_t totalNodes = 0;
+    double totalSeconds = 0;
+    uint64_t checkCalls = 0;
+    uint64_t sink = 0;
+    double checkNs = 0;
+    double legacyCheckNs = 0;
+
+    std::cout << "perft\n";
+    for (const PerftCase& c : cases) {
+        ChessPosition position;
+        position.setFen(c.fen);
+        auto start = BenchClock::now();
+        uint64_t nodes = perft(perft, position, c.depth, [](const ChessPosition&) {});
+        double seconds = nanosecondsSince(start) / 1e9;
+        totalNodes += nodes;
+        totalSeconds += seconds;
+        ok = ok && nodes == c.nodes;
+        std::cout << "  " << std::left << std::setw(10) << c.name << std::right << " depth " << c.depth
+            << std::setw(10) << nodes << (nodes == c.nodes ? " ok " : " WRONG ") << std::fixed << std::setprecision(2)
+            << std::setw(8) << nodes / seconds / 1e6 << " Mnodes/s\n";
+
+        perft(perft, position, c.depth, [&](const ChessPosition& p) {
+            const int repetitions = 8;
+            auto t = BenchClock::now();
+            for (int r = 0; r < repetitions; r++) sink += p.isInCheck(p.isWhiteToMove());
+            checkNs += nanosecondsSince(t);
+            t = BenchClock::now();
+            for (int r = 0; r < repetitions; r++) sink += legacyIsInCheck(p, p.isWhiteToMove());
+            legacyCheckNs += nanosecondsSince(t);
+            checkCalls += repetitions;
+        });
+    }
+    std::cout << std::setprecision(1)
+        << "  isInCheck at interior nodes     " << std::setw(8) << checkNs / checkCalls << " ns/call (ray walk "
+        << legacyCheckNs / checkCalls << ")\n"
+        << "  (checksum " << sink << ")\n" << std::endl;
+
+    report.add("perft.speed", totalNodes / totalSeconds, "nodes/s");
+    report.add("perft.isInCheck", checkNs / checkCalls, "ns/call");
+    report.add("perft.isInCheck.rayWalk", legacyCheckNs / checkCalls, "ns/call");
+    report.add("perft.wrongCounts", ok ? 0 : 1, "cases");
+    return ok;
+}
+
+// The search output parsing as it was: a find() per field over every line, score and mate only. The mate
+// distance is parsed into `mateIn` and then, as before, never used.
+static void legacyParseSearchLine(const std::string& line, SearchResult& result, int& mateIn) {
+    auto infoValue = [&line](const char* key, uint64_t fallback) {
+        size_t at = line.find(key);
+        if (at == std::string::npos) return fallback;
+        uint64_t value = fallback;
+        const char* start = line.data() + at + std::strlen(key);
+        std::from_chars(start, line.data() + line.size(), value);
+        return value;
+    };
+
+    std::size_t cpPos = line.find("score cp ");
+    if (cpPos != std::string::npos) {
+        int score = 0;
+        std::from_chars(line.data() + cpPos + 9, line.data() + line.size(), score);
+        result.score = score;
+        mateIn = 0;
+    }
+    std::size_t matePos = line.find("score mate ");
+    if (matePos != std::string::npos) {
+        std::from_chars(line.data() + matePos + 11, line.data() + line.size(), mateIn);
+    }
+    if (line.rfind("info depth", 0) == 0) {
+        result.nodes = infoValue(" nodes ", result.nodes);
+        result.nps = infoValue(" nps ", result.nps);
+    }
+}
+
+// One depth-18 search's worth of Stockfish output, folded into a SearchResult line by line.
+static bool benchSearchLines() {
+    std::vector<std::string> lines = {
+        "info string Available processors: 0-11",
+        "info string NNUE evaluation using nn-1c0000000000.nnue (133MiB, (22528, 3072, 15, 32, 1))",
+    };
+    std::mt19937 random(7);
+    const char* moves[] = { "e2e4", "e7e5", "g1f3", "b8c6", "f1b5", "a7a6", "b5a4", "g8f6", "e1g1", "f8e7", "e7e8q" };
+    for (int depth = 1; depth <= 18; depth++) {
+        std::ostringstream line;
+        line << "info depth " << depth << " seldepth " << depth + 4 << " multipv 1 score ";
+        if (depth == 18) line << "mate -7";
+        else line << "cp " << static_cast<int>(random() % 100) - 50;
+        if (depth % 5 == 0) line << " lowerbound";
+        line << " nodes " << 1000 * depth * depth << " nps 640000 hashfull " << depth << " tbhits 0 time " << 2 * depth << " pv";
+        for (int m = 0; m < 2 + depth; m++) line << " " << moves[(depth + m) % 11];
+        lines.push_back(line.str());
+        if (depth > 12) lines.push_back("info depth " + std::to_string(depth) + " currmove e2e4 currmovenumber 1");
+    }
+    lines.push_back("bestmove e2e4 ponder e7e5");
+
+    const int repetitions = 20000;
+    SearchResult legacy;
+    int legacyMateIn = 0;
+    auto start = BenchClock::now();
+    for (int r = 0; r < repetitions; r++) {
+        legacy = SearchResult();
+        for (const std::string& line : lines) legacyParseSearchLine(line, legacy, legacyMateIn);
+    }
+    double legacyNs = nanosecondsSince(start) / (double(repetitions) * lines.size());
+
+    SearchResult result;
+    size_t allocationsBefore = allocationCount;
+    start = BenchClock::now();
+    for (int r = 0; r < repetitions; r++) {
+        result = SearchResult();
+        for (const std::string& line : lines) {
+            InfoLine info;
+            if (InfoLine::parse(line, info)) result.addInfo(info);
+        }
+        result.decodePrincipalVariation(); // as readSearchLine does on "bestmove"
+    }
+    double tokenizerNs = nanosecondsSince(start) / (double(repetitions) * lines.size());
+    size_t allocations = allocationCount - allocationsBefore;
+
+    bool ok = result.score == legacy.score && result.mate == -7 && legacyMateIn == -7 && result.nodes == legacy.nodes &&
+        result.nps == legacy.nps && result.seldepth == 22 && result.pvLength == 20 && result.pv[14] == parseUciMove("e7e8q");
+    std::cout << "Search output parsing (" << lines.size() << " lines per search)\n" << std::fixed << std::setprecision(1)
+        << "  find() per field                " << std::setw(8) << legacyNs << " ns/line (score, mate, nodes, nps)\n"
+        << "  InfoLine tokenizer              " << std::setw(8) << tokenizerNs << " ns/line (also seldepth, bounds, PV), "
+        << allocations << " allocations\n"
+        << "  results match                   " << std::setw(8) << (ok ? "yes" : "no") << "\n" << std::endl;
+
+    report.add("searchLines.legacy", legacyNs, "ns/line");
+    report.add("searchLines.tokenizer", tokenizerNs, "ns/line");
+    report.add("searchLines.allocations", double(allocations), "allocations");
+    return ok;
+}
+
+// Rows as analyzeGame builds them, with made-up evaluations, for measuring the output stage alone.
+static std::vector<GameRows> buildRows(const std::vector<GameData>& games) {
+    std::vector<GameRows> allRows;
+    for (const GameData& game : games) {
+        GameRows rows;
+        rows.gameId = game.gameId;
+        ChessPosition position;
+        std::strcpy(rows.rows.emplace_back().fenAfter, "startup");
+        for (size_t i = 0; i < game.moves.size(); i++) {
+            if (!position.makeMove(game.moves[i])) break;
+            PlyRow& row = rows.rows.emplace_back();
+            row.ply = static_cast<uint32_t>(i + 1);
+            row.kingSideCastle = position.kingSideCastle();
+            row.queenSideCastle = position.queenSideCastle();
+            row.checkAfter = position.isInCheck(position.isWhiteToMove());
+            row.evalBefore = static_cast<double>(position.hash() % 601) - 300;
+            row.evalAfter = static_cast<double>(position.hash() % 701) - 350;
+            row.timeRemaining = (1800 - static_cast<int>(i) * 7) * 0.1;
+            row.timeSpentOnMoveBeforeIt = (i % 13) * 0.1 * 0.1;
+            row.legalMovesBefore = 20 + i % 17;
+            row.legalMovesAfter = position.countLegalMoves();
+            row.timeSpent = (i % 11) * 0.1;
+            row.mateAfter = position.hash() % 9 == 0 ? static_cast<int8_t>(static_cast<int>(position.hash() % 15) - 7) : int8_t(0);
+            row.searchAfter.seldepth = static_cast<uint8_t>(10 + i % 9);
+            row.searchAfter.nodes = position.hash() % 5000000;
+            row.searchAfter.nps = 600000 + position.hash() % 100000;
+            // The game's next moves stand in for the best move and principal variation
+            for (size_t m = i + 1; m < game.moves.size() && m < i + 1 + i % 12; m++) {
+                row.searchAfter.pv[row.searchAfter.pvLength++] = game.moves[m];
+            }
+            if (row.searchAfter.pvLength > 0) row.searchAfter.bestMove = row.searchAfter.pv[0];
+            std::strcpy(row.fenBefore, rows.rows[rows.rows.size() - 2].fenAfter);
+            position.writeFen(row.fenAfter);
+        }
+        rows.rows.erase(rows.rows.begin());
+        allRows.push_back(std::move(rows));
+    }
+    return allRows;
+}
+
+// Throughput of the CSV writer (formatting, writer thread and file writes) against formatting the
+// same rows through an ostringstream, which is what analyzeGame used to do.
+static void benchCsv(const std::vector<GameData>& games) {
+    const int repetitions = 5;
+    std::vector<GameRows> allRows = buildRows(games);
+    size_t rowCount = 0;
+    for (const GameRows& rows : allRows) rowCount += rows.rows.size();
+
+    size_t bytes = 0;
+    auto start = BenchClock::now();
+    for (int rep = 0; rep < repetitions; rep++) {
+        for (const GameRows& rows : allRows) {
+            std::ostringstream file;
+            for (const PlyRow& r : rows.rows) {
+                file << r.ply << "," << (r.kingSideCastle ? 1 : 0) << "," << (r.queenSideCastle ? 1 : 0) << "," << (r.checkBefore ? 1 : 0) << "," << (r.checkAfter ? 1 : 0) << "," << r.evalAfter - r.evalBefore << "," << r.evalBefore << "," << r.evalAfter << "," << r.timeRemaining << "," << r.timeSpentOnMoveBeforeIt << "," << r.legalMovesBefore << "," << r.legalMovesAfter << "," << r.timeSpent << "," << r.fenBefore << "," << r.fenAfter << ",";
+                // The columns added since, formatted the same way
+                file << int(r.depthAfter) << ",";
+                if (r.mateAfter != 0) file << int(r.mateAfter);
+                file << "," << int(r.searchAfter.seldepth) << "," << r.searchAfter.nodes << "," << r.searchAfter.nps << ",";
+                if (r.searchAfter.bestMove != InvalidMove) file << moveToUci(r.searchAfter.bestMove);
+                file << ",";
+                for (size_t m = 0; m < r.searchAfter.pvLength; m++) file << (m > 0 ? " " : "") << moveToUci(r.searchAfter.pv[m]);
+                file << ",\n";
+            }
+            bytes += file.str().size();
+        }
+    }
+    double streamNs = nanosecondsSince(start) / (rowCount * repetitions);
+
+    std::filesystem::path path = std::filesystem::temp_directory_path() / "CMakeProject3Bench.csv";
+    std::filesystem::remove(path);
+    start = BenchClock::now();
+    {
+        CsvWriter writer;
+        writer.open(path.string());
+        for (int rep = 0; rep < repetitions; rep++) {
+            for (const GameRows& rows : allRows) writer.submit(rows);
+        }
+        writer.close();
+    }
+    double writerNs = nanosecondsSince(start) / (rowCount * repetitions);
+    uintmax_t fileBytes = std::filesystem::file_size(path);
+    std::filesystem::remove(path);
+
+    std::cout << "CSV emission of " << rowCount << " rows (" << repetitions << " passes)\n" << std::fixed << std::setprecision(1)
+        << "  ostringstream formatting        " << std::setw(8) << streamNs << " ns/row\n"
+        << "  CsvWriter to file               " << std::setw(8) << writerNs << " ns/row, "
+        << fileBytes / (writerNs * rowCount * repetitions / 1e9) / (1024 * 1024) << " MB/s\n"
+        << "  bytes match                     " << std::setw(8) << (bytes == fileBytes ? "yes" : "no") << "\n" << std::endl;
+
+    report.add("csv.ostringstream", streamNs, "ns/row");
+    report.add("csv.writer", writerNs, "ns/row");
+}
+
+// Writes the rows with ColumnarWriter in chunks of a few thousand rows, reads the file back with
+// ColumnarReader and compares every column of every row, FEN dictionaries and search columns included.
+// A torn chunk is then appended, as an interrupted run leaves one, and must be ignored. Returns false
+// on any difference.
+static bool benchColumnar(const std::vector<GameData>& games) {
+    std::vector<GameRows> allRows = buildRows(games);
+    size_t rowCount = 0;
+    for (GameRows& rows : allRows) {
+        for (PlyRow& row : rows.rows) row.depthAfter = static_cast<uint8_t>(1 + (rowCount++ % StockfishEngine::searchDepth));
+    }
+
+    std::filesystem::path path = std::filesystem::temp_directory_path() / "CMakeProject3Bench.cols";
+    std::filesystem::remove(path);
+    auto start = BenchClock::now();
+    {
+        ColumnarWriter writer(4096);
+        writer.open(path.string());
+        for (const GameRows& rows : allRows) writer.submit(rows);
+        writer.close();
+    }
+    double writeNs = nanosecondsSince(start) / std::max<size_t>(rowCount, 1);
+
+    // Reads the file back and counts the rows that differ from allRows; `chunks` gets the number of chunks.
+    auto verify = [&](size_t& chunks) {
+        ColumnarReader reader;
+        if (!reader.open(path.string()) || reader.rowCount() != rowCount) return size_t(1);
+        using Format = ColumnarFormat;
+        size_t differences = 0;
+        size_t game = 0;
+        size_t ply = 0;
+        chunks = reader.chunks().size();
+        for (const ColumnarReader::Chunk& chunk : reader.chunks()) {
+            auto plies = chunk.column<uint32_t>(Format::Ply);
+            auto flags = [&](Format::Column column) { return chunk.column<uint8_t>(column); };
+            auto numbers = [&](Format::Column column) { return chunk.column<double>(column); };
+            auto fenBefore = chunk.column<uint32_t>(Format::FenBefore);
+            auto fenAfter = chunk.column<uint32_t>(Format::FenAfter);
+            auto mates = chunk.column<int8_t>(Format::Mate);
+            auto bestMoves = chunk.column<uint16_t>(Format::BestMove);
+            auto nodes = chunk.column<uint64_t>(Format::Nodes);
+            auto nps = chunk.column<uint64_t>(Format::Nps);
+            if (plies.size() != chunk.rowCount() || fenBefore.size() != chunk.rowCount() ||
+                flags(Format::SearchDepth).size() != chunk.rowCount() || mates.size() != chunk.rowCount() ||
+                bestMoves.size() != chunk.rowCount() || nodes.size() != chunk.rowCount()) return differences + 1;
+
+            for (uint32_t r = 0; r < chunk.rowCount(); r++) {
+                while (game < allRows.size() && ply == allRows[game].rows.size()) {
+                    game++;
+                    ply = 0;
+                }
+                if (game == allRows.size()) return differences + 1;
+                const PlyRow& row = allRows[game].rows[ply++];
+                bool same = plies[r] == row.ply &&
+                    flags(Format::KingSideCastle)[r] == row.kingSideCastle &&
+                    flags(Format::QueenSideCastle)[r] == row.queenSideCastle &&
+                    flags(Format::CheckBefore)[r] == row.checkBefore &&
+                    flags(Format::CheckAfter)[r] == row.checkAfter &&
+                    numbers(Format::EvalDelta)[r] == row.evalAfter - row.evalBefore &&
+                    numbers(Format::EvalBefore)[r] == row.evalBefore &&
+                    numbers(Format::EvalAfter)[r] == row.evalAfter &&
+                    numbers(Format::TimeRemaining)[r] == row.timeRemaining &&
+                    numbers(Format::TimeSpentOnMoveBeforeIt)[r] == row.timeSpentOnMoveBeforeIt &&
+                    flags(Format::LegalMovesBefore)[r] == row.legalMovesBefore &&
+                    flags(Format::LegalMovesAfter)[r] == row.legalMovesAfter &&
+                    numbers(Format::TimeSpent)[r] == row.timeSpent &&
+                    chunk.fen(fenBefore[r]) == row.fenBefore &&
+                    chunk.fen(fenAfter[r]) == row.fenAfter &&
+                    flags(Format::SearchDepth)[r] == row.depthAfter &&
+                    mates[r] == row.mateAfter &&
+                    flags(Format::SelDepth)[r] == row.searchAfter.seldepth &&
+                    nodes[r] == row.searchAfter.nodes &&
+                    nps[r] == row.searchAfter.nps &&
+                    bestMoves[r] == row.searchAfter.bestMove &&
+                    std::ranges::equal(chunk.pv(r), std::span<const Move>(row.searchAfter.pv, row.searchAfter.pvLength));
+                if (!same) differences++;
+            }
+        }
+        return differences;
+    };
+
+    size_t chunks = 0;
+    start = BenchClock::now();
+    size_t differences = verify(chunks);
+    double readNs = nanosecondsSince(start) / std::max<size_t>(rowCount, 1);
+
+    // Half a chunk header of garbage after the last complete chunk
+    {
+        std::ofstream torn(path, std::ios::binary | std::ios::app);
+        ColumnarFormat::ChunkHeader header = {};
+        header.magic = ColumnarFormat::ChunkMagic;
+        torn.write(reinterpret_cast<const char*>(&header), sizeof(header) / 2);
+    }
+    size_t tornChunks = 0;
+    size_t tornDifferences = verify(tornChunks);
+    std::filesystem::remove(path);
+
+    bool ok = differences == 0 && tornDifferences == 0 && tornChunks == chunks && chunks > 1;
+    std::cout << "columnar round trip of " << rowCount << " rows (" << chunks << " chunks, format version "
+        << ColumnarFormat::Version << ")\n" << std::fixed << std::setprecision(1)
+        << "  ColumnarWriter to file          " << std::setw(8) << writeNs << " ns/row\n"
+        << "  ColumnarReader and compare      " << std::setw(8) << readNs << " ns/row\n"
+        << "  differences                     " << std::setw(8) << differences << " (" << tornDifferences
+        << " with a torn chunk appended)\n" << std::endl;
+
+    report.add("columnar.write", writeNs, "ns/row");
+    report.add("columnar.readAndCompare", readNs, "ns/row");
+    report.add("columnar.differences", static_cast<double>(differences + tornDifferences), "rows");
+    return ok;
+}
+
+// Plies per second through GameAnalyzer::analyzeGames with one MockEngine answering instantly,
+// which is the analyzer's own overhead including the pipe round trips. Every mode must write the
+// same bytes as the first; returns false if one differs.
+static bool benchEndToEnd(const std::vector<GameData>& games, const std::string& enginePath) {
+    std::filesystem::path path = std::filesystem::temp_directory_path() / "CMakeProject3Bench.e2e.csv";
+    auto removeOutput = [&path]() {
+        for (const char* suffix : { "", ".manifest", ".progress" }) {
+            std::filesystem::remove(path.string() + suffix);
+        }
+    };
+
+    size_t plies = 0;
+    for (const GameData& game : games) plies += game.moves.size();
+
+    // The default shared-prefix analysis, then per-game analysis with and without ply pipelining
+    struct Mode {
+        const char* label;
+        const char* name;
+        bool sharedPrefixes;
+        bool pipelining;
+    };
+    const Mode modes[] = {
+        { "analyzeGames                    ", "endToEnd.throughput", true, false },
+        { "  per game, pipelined plies     ", "endToEnd.perGamePipelined", false, true },
+        { "  per game, one ply at a time   ", "endToEnd.perGameSequential", false, false },
+    };
+
+    std::cout << "end to end against " << enginePath << "\n" << std::fixed;
+    bool ok = true;
+    std::string firstOutput;
+    for (const Mode& mode : modes) {
+        removeOutput();
+        double seconds = 0;
+        {
+            // The engine layout and every analyzed game are reported on the console; keep that out of the results.
+            std::ostringstream discarded;
+            std::streambuf* console = std::cout.rdbuf(discarded.rdbuf());
+            GameAnalyzer analyzer;
+            analyzer.setSharedPrefixes(mode.sharedPrefixes);
+            analyzer.setPlyPipelining(mode.pipelining);
+            if (!analyzer.init(1, 1, 16, enginePath) || !analyzer.openOutput(path.string())) {
+                std::cout.rdbuf(console);
+                std::cout << "end to end: could not start " << enginePath << "\n" << std::endl;
+                removeOutput();
+                return false;
+            }
+
+            auto start = BenchClock::now();
+            ok = analyzer.analyzeGames(games, "bench") && ok;
+            seconds = nanosecondsSince(start) / 1e9;
+            std::cout.rdbuf(console);
+        }
+
+        std::ifstream in(path, std::ios::binary);
+        std::string output((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        if (&mode == &modes[0]) firstOutput = std::move(output);
+        bool same = &mode == &modes[0] || output == firstOutput;
+        ok = same && ok;
+
+        std::cout << "  " << mode.label << std::setprecision(1) << std::setw(8) << plies / seconds << " plies/s ("
+            << plies << " plies in " << std::setprecision(2) << seconds << " s)" << (same ? "" : ", output differs") << "\n";
+        report.add(mode.name, plies / seconds, "plies/s");
+    }
+    std::cout << "  outputs match                   " << std::setw(8) << (ok ? "yes" : "no") << "\n";
+    std::cout << std::endl;
+    removeOutput();
+    return ok;
+}
+
+// The engine's legal move count ("go perft 1"), which the analyzer falls back on when its own board has
+// lost track of a game, against ChessPosition::countLegalMoves. Every other position goes through a whole
+// request (beginSearch with legalMoves -1) instead of countLegalMoves, so whatever either leaves in the
+// pipe shows up in the next count. Returns false if any count differs.
+static bool benchEnginePerft(const std::vector<ChessPosition>& positions, const std::string& enginePath) {
+    const size_t sampleCount = std::min<size_t>(positions.size(), 200);
+    StockfishEngine engine;
+    if (!engine.init(enginePath, 1, 16)) {
+        std::cout << "engine perft: could not start " << enginePath << "\n" << std::endl;
+        return false;
+    }
+
+    size_t mismatches = 0;
+    char fen[ChessPosition::FenBufferSize];
+    auto start = BenchClock::now();
+    for (size_t i = 0; i < sampleCount; i++) {
+        const ChessPosition& position = positions[i * positions.size() / sampleCount];
+        position.writeFen(fen);
+        int engineCount;
+        if (i % 2 == 0) {
+            engine.sendCommand(std::string("position fen ") + fen);
+            engineCount = engine.countLegalMoves();
+        }
+        else {
+            SearchRequest request;
+            request.command = std::string("position fen ") + fen;
+            engine.beginSearch(request);
+            SearchResult result;
+            engine.finishSearch(result);
+            engineCount = static_cast<int>(result.legalMoves);
+        }
+        if (engineCount != position.countLegalMoves()) mismatches++;
+    }
+    double perPosition = nanosecondsSince(start) / 1e3 / std::max<size_t>(sampleCount, 1);
+
+    std::cout << "engine legal move counts over " << sampleCount << " positions\n" << std::fixed << std::setprecision(1)
+        << "  go perft 1 (and search)         " << std::setw(8) << perPosition << " us/position\n"
+        << "  mismatches                      " << std::setw(8) << mismatches << "\n" << std::endl;
+
+    report.add("enginePerft.mismatches", static_cast<double>(mismatches), "positions");
+    return mismatches == 0;
+}
+
+// Searches per second through EngineEventLoop with 1, 4 and 16 engines driven from one thread, each
+// search submitted as soon as a future is free. Returns false if a search went unanswered.
+static bool benchEventLoop(const std::vector<ChessPosition>& positions, const std::string& enginePath) {
+    const size_t searchCount = std::min<size_t>(positions.size(), 4000);
+    std::vector<std::string> commands;
+    char fen[ChessPosition::FenBufferSize];
+    for (size_t i = 0; i < searchCount; i++) {
+        positions[i * positions.size() / searchCount].writeFen(fen);
+        commands.push_back(std::string("position fen ") + fen);
+    }
+
+    std::cout << "event loop over " << searchCount << " searches\n" << std::fixed << std::setprecision(1);
+    bool ok = true;
+    for (size_t engineCount : { 1, 4, 16 }) {
+        EnginePool pool;
+        if (!pool.init(engineCount, static_cast<int>(engineCount), static_cast<int>(16 * engineCount), enginePath)) {
+            std::cout << "  could not start " << engineCount << " engines of " << enginePath << "\n" << std::endl;
+            return false;
+        }
+        std::vector<StockfishEngine*> engines;
+        for (size_t e = 0; e < engineCount; e++) engines.push_back(&pool.engine(e));
+
+        size_t unanswered = 0;
+        auto start = BenchClock::now();
+        {
+            EngineEventLoop loop(engines);
+            std::vector<std::future<SearchResult>> running;
+            for (size_t i = 0; i < searchCount; i++) {
+                if (running.size() == 2 * engineCount) {
+                    for (auto& result : running) unanswered += result.get().completed ? 0 : 1;
+                    running.clear();
+                }
+                SearchRequest request;
+                request.command = commands[i];
+                request.legalMoves = positions[i * positions.size() / searchCount].countLegalMoves();
+                running.push_back(loop.search(i % engineCount, std::move(request)));
+            }
+            for (auto& result : running) unanswered += result.get().completed ? 0 : 1;
+        }
+        double seconds = nanosecondsSince(start) / 1e9;
+
+        std::cout << "  " << std::setw(2) << engineCount << " engines, one loop thread " << std::setw(10)
+            << searchCount / seconds << " searches/s, " << unanswered << " unanswered\n";
+        report.add("eventLoop.engines" + std::to_string(engineCount), searchCount / seconds, "searches/s");
+        ok = ok && unanswered == 0;
+    }
+    std::cout << std::endl;
+    return ok;
+}
+
+int main(int argc, char* argv[]) {
+    std::string dataFile = BENCH_DATA_FILE;
+    std::string enginePath = BENCH_ENGINE;
+    std::string jsonPath;
+    bool checksOnly = false;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--check") {
+            checksOnly = true;
+        }
+        else if ((arg == "--json" || arg == "--engine") && i + 1 < argc) {
+            (arg == "--json" ? jsonPath : enginePath) = argv[++i];
+        }
+        else {
+            dataFile = arg;
+        }
+    }
+
+    GameAnalyzer analyzer;
+    GameArena arena = analyzer.parseGameFile(dataFile);
+    const std::vector<GameData>& games = arena.games();
+    if (games.empty()) {
+        std::cout << "No games found in " << dataFile << std::endl;
+        return 1;
+    }
+
+    bool ok = benchParse(dataFile);
+    if (!checksOnly) benchPositionCommands(games);
+    ok = benchMakeMove(games) && ok;
+    std::vector<ChessPosition> positions = replayPositions(games);
+    ok = benchMakeUnmake(positions) && ok;
+    ok = benchAttacks(positions) && ok;
+    ok = benchPerft() && ok;
+    ok = benchSearchLines() && ok;
+    if (!checksOnly) benchCsv(games);
+    ok = benchColumnar(games) && ok;
+    ok = benchEnginePerft(positions, enginePath) && ok;
+    if (!checksOnly) ok = benchEventLoop(positions, enginePath) && ok;
+    // The checks only need the modes to agree, which a slice of the file shows quickly
+    std::vector<GameData> endToEndGames(games.begin(), games.begin() + (checksOnly ? std::min<size_t>(games.size(), 150) : games.size()));
+    ok = benchEndToEnd(endToEndGames, enginePath) && ok;
+
+    if (!jsonPath.empty() && !report.writeJson(jsonPath, dataFile)) {
+        std::cout << "Could not write " << jsonPath << std::endl;
+        return 1;
+    }
+    return ok ? 0 : 1;
+}
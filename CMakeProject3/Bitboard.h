@@ -0,0 +1,235 @@
+﻿// Bitboard.h : Square sets, packed moves and the precomputed attack tables
+// used by ChessPosition.
+
+#pragma once
+
+#include <cstdint>
+#include <bit>
+#if defined(__BMI2__)
+#include <immintrin.h>
+#endif
+
+// Bitboards use one bit per square, a1 = bit 0, b1 = bit 1, ..., h8 = bit 63 (square = rank * 8 + file).
+using Bitboard = uint64_t;
+
+// Moves are packed into 16 bits: from square (6 bits), to square (6 bits), promotion piece (3 bits).
+using Move = uint16_t;
+
+enum PieceType { Pawn, Knight, Bishop, Rook, Queen, King, PieceTypeCount };
+enum Promotion { NoPromotion, PromoteKnight, PromoteBishop, PromoteRook, PromoteQueen };
+
+inline Move encodeMove(int from, int to, int promotion = NoPromotion) {
+    return static_cast<Move>(from | (to << 6) | (promotion << 12));
+}
+inline int moveFrom(Move move) { return move & 63; }
+inline int moveTo(Move move) { return (move >> 6) & 63; }
+inline int movePromotion(Move move) { return (move >> 12) & 7; }
+
+inline Bitboard squareBit(int square) { return Bitboard(1) << square; }
+inline int lowestSquare(Bitboard b) { return std::countr_zero(b); }
+inline int highestSquare(Bitboard b) { return 63 - std::countl_zero(b); }
+
+// Sliding attacks of one square by table lookup: the occupancy of the squares that can block the
+// slider (`mask`) is hashed into an index by a magic multiply, or by PEXT when compiling for BMI2.
+struct SlidingMagic {
+    Bitboard mask;
+    Bitboard magic;
+    uint32_t offset; // of this square's entries in the table
+    unsigned shift;
+
+    unsigned index(Bitboard occupied) const {
+#if defined(__BMI2__)
+        return static_cast<unsigned>(_pext_u64(occupied, mask));
+#else
+        return static_cast<unsigned>(((occupied & mask) * magic) >> shift);
+#endif
+    }
+};
+
+// Precomputed attack sets for the leapers, the rays the sliders move along, and the magic
+// lookup tables for bishop and rook attacks.
+struct AttackTables {
+    // Ray directions: the first four run towards higher square numbers, the last four towards lower ones.
+    enum Direction { North, East, NorthEast, NorthWest, South, West, SouthWest, SouthEast, DirectionCount };
+
+    static constexpr int RookTableSize = 0x19000;  // sum over squares of 2^(relevant occupancy bits)
+    static constexpr int BishopTableSize = 0x1480;
+
+    Bitboard knight[64];
+    Bitboard king[64];
+    Bitboard pawn[2][64];          // [color][square], 0 = white
+    Bitboard rays[DirectionCount][64];
+    Bitboard between[64][64];      // squares strictly between two aligned squares
+    Bitboard line[64][64];         // the whole line through two aligned squares
+    SlidingMagic rookMagics[64];
+    SlidingMagic bishopMagics[64];
+    Bitboard rookTable[RookTableSize];
+    Bitboard bishopTable[BishopTableSize];
+
+    AttackTables() {
+        const int rankStep[DirectionCount] = { 1, 0, 1, 1, -1, 0, -1, -1 };
+        const int fileStep[DirectionCount] = { 0, 1, 1, -1, 0, -1, -1, 1 };
+        const int knightSteps[8][2] = { {-2,-1},{-2,1},{-1,-2},{-1,2},{1,-2},{1,2},{2,-1},{2,1} };
+
+        auto onBoard = [](int rank, int file) { return rank >= 0 && rank < 8 && file >= 0 && file < 8; };
+
+        for (int square = 0; square < 64; square++) {
+            int rank = square / 8, file = square % 8;
+
+            knight[square] = king[square] = pawn[0][square] = pawn[1][square] = 0;
+            for (auto& step : knightSteps) {
+                if (onBoard(rank + step[0], file + step[1])) knight[square] |= squareBit((rank + step[0]) * 8 + file + step[1]);
+            }
+            for (int dr = -1; dr <= 1; dr++) {
+                for (int df = -1; df <= 1; df++) {
+                    if ((dr != 0 || df != 0) && onBoard(rank + dr, file + df)) king[square] |= squareBit((rank + dr) * 8 + file + df);
+                }
+            }
+            for (int df = -1; df <= 1; df += 2) {
+                if (onBoard(rank + 1, file + df)) pawn[0][square] |= squareBit((rank + 1) * 8 + file + df);
+                if (onBoard(rank - 1, file + df)) pawn[1][square] |= squareBit((rank - 1) * 8 + file + df);
+            }
+
+            for (int d = 0; d < DirectionCount; d++) {
+                rays[d][square] = 0;
+                for (int r = rank + rankStep[d], f = file + fileStep[d]; onBoard(r, f); r += rankStep[d], f += fileStep[d]) {
+                    rays[d][square] |= squareBit(r * 8 + f);
+                }
+            }
+        }
+
+        for (int from = 0; from < 64; from++) {
+            for (int to = 0; to < 64; to++) between[from][to] = line[from][to] = 0;
+            for (int d = 0; d < DirectionCount; d++) {
+                int opposite = (d + 4) % DirectionCount;
+                Bitboard fullLine = rays[d][from] | rays[opposite][from] | squareBit(from);
+                Bitboard path = 0;
+                int rank = from / 8 + rankStep[d], file = from % 8 + fileStep[d];
+                for (; onBoard(rank, file); rank += rankStep[d], file += fileStep[d]) {
+                    int to = rank * 8 + file;
+                    between[from][to] = path;
+                    line[from][to] = fullLine;
+                    path |= squareBit(to);
+                }
+            }
+        }
+
+        const int rookDirections[4] = { North, East, South, West };
+        const int bishopDirections[4] = { NorthEast, NorthWest, SouthWest, SouthEast };
+        initSliders(rookMagics, rookTable, rookDirections);
+        initSliders(bishopMagics, bishopTable, bishopDirections);
+    }
+
+    // Fills the magic lookup of one slider type from the ray attacks. The magics are found by trial
+    // with a fixed-seed generator (the per-rank seeds are known to converge quickly), so the tables
+    // come out the same on every run and take a few milliseconds to build.
+    void initSliders(SlidingMagic* magics, Bitboard* table, const int* directions) {
+        const uint64_t seeds[8] = { 728, 10316, 55013, 32803, 12281, 15100, 16645, 255 };
+        const Bitboard edgeRanks = 0xFF000000000000FFULL;
+        const Bitboard edgeFiles = 0x8181818181818181ULL;
+
+        Bitboard occupancies[4096];
+        Bitboard reference[4096];
+        int epoch[4096] = {};
+        int attempt = 0;
+        uint32_t offset = 0;
+
+        for (int square = 0; square < 64; square++) {
+            SlidingMagic& m = magics[square];
+            Bitboard rank = 0xFFULL << (square / 8 * 8);
+            Bitboard file = 0x0101010101010101ULL << (square % 8);
+            Bitboard edges = (edgeRanks & ~rank) | (edgeFiles & ~file);
+
+            m.mask = 0;
+            for (int d = 0; d < 4; d++) m.mask |= rays[directions[d]][square];
+            m.mask &= ~edges;
+            m.shift = 64 - std::popcount(m.mask);
+            m.offset = offset;
+
+            // Every subset of the mask, with the attacks it leaves (Carry-Rippler enumeration).
+            int size = 0;
+            Bitboard subset = 0;
+            do {
+                occupancies[size] = subset;
+                reference[size] = 0;
+                for (int d = 0; d < 4; d++) reference[size] |= slidingRay(directions[d], square, subset);
+                size++;
+                subset = (subset - m.mask) & m.mask;
+            } while (subset);
+
+#if defined(__BMI2__)
+            m.magic = 0;
+            for (int i = 0; i < size; i++) table[offset + m.index(occupancies[i])] = reference[i];
+#else
+            uint64_t state = seeds[square / 8];
+            auto next = [&state]() { // xorshift64*
+                state ^= state >> 12;
+                state ^= state << 25;
+                state ^= state >> 27;
+                return state * 2685821657736338717ULL;
+            };
+
+            // Try sparse candidates until one maps every subset to a slot without a conflicting attack set.
+            for (int i = 0; i < size;) {
+                do {
+                    m.magic = next() & next() & next();
+                } while (std::popcount((m.magic * m.mask) >> 56) < 6);
+
+                for (++attempt, i = 0; i < size; i++) {
+                    unsigned index = m.index(occupancies[i]);
+                    if (epoch[index] < attempt) {
+                        epoch[index] = attempt;
+                        table[offset + index] = reference[i];
+                    }
+                    else if (table[offset + index] != reference[i]) {
+                        break;
+                    }
+                }
+            }
+#endif
+            offset += static_cast<uint32_t>(size);
+        }
+    }
+
+    Bitboard slidingRay(int direction, int square, Bitboard occupied) const {
+        Bitboard attacks = rays[direction][square];
+        Bitboard blockers = attacks & occupied;
+        if (blockers) {
+            int blocker = direction < South ? lowestSquare(blockers) : highestSquare(blockers);
+            attacks ^= rays[direction][blocker];
+        }
+        return attacks;
+    }
+
+    Bitboard bishopAttacks(int square, Bitboard occupied) const {
+        const SlidingMagic& m = bishopMagics[square];
+        return bishopTable[m.offset + m.index(occupied)];
+    }
+
+    Bitboard rookAttacks(int square, Bitboard occupied) const {
+        const SlidingMagic& m = rookMagics[square];
+        return rookTable[m.offset + m.index(occupied)];
+    }
+};
+
+inline const AttackTables attackTables;
+
+// Piece placement of a ChessPosition as bitboards, indexed [color][PieceType] with 0 = white.
+struct BoardBitboards {
+    bool operator==(const BoardBitboards&) const = default;
+
+    Bitboard pieces[2][PieceTypeCount] = {};
+    Bitboard byColor[2] = {};
+    Bitboard occupied = 0;
+    int kingSquare[2] = { -1, -1 };
+
+    // All pieces of `color` that attack `square`, with sliders blocked by `occupancy`.
+    Bitboard attackersTo(int square, int color, Bitboard occupancy) const {
+        const Bitboard* p = pieces[color];
+        return (attackTables.pawn[color ^ 1][square] & p[Pawn]) |
+            (attackTables.knight[square] & p[Knight]) |
+            (attackTables.king[square] & p[King]) |
+            (attackTables.bishopAttacks(square, occupancy) & (p[Bishop] | p[Queen])) |
+            (attackTables.rookAttacks(square, occupancy) & (p[Rook] | p[Queen]));
+    }
+};
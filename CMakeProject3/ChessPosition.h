@@ -0,0 +1,775 @@
+﻿// ChessPosition.h : Board tracking for the analyzed games: move application,
+// check detection, legal move generation and FEN output.
+
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <array>
+#include <utility>
+#include <charconv>
+
+#include "Bitboard.h"
+
+// PieceType of a board character such as 'N' or 'q', or -1 for an empty square.
+inline int pieceTypeOf(char piece) {
+    switch (piece | 0x20) { // lower case
+    case 'p': return Pawn;
+    case 'n': return Knight;
+    case 'b': return Bishop;
+    case 'r': return Rook;
+    case 'q': return Queen;
+    case 'k': return King;
+    default: return -1;
+    }
+}
+
+// A game record move that is not a UCI move. No legal move encodes to it (promotion 7).
+inline constexpr Move InvalidMove = 0xFFFF;
+
+// Writes the move in UCI notation, e.g. "e2e4", "e1g1" for castling or "e7e8q", to `out` (room for 5
+// characters, no NUL) and returns the end. InvalidMove is written as the null move "0000".
+inline char* writeUci(Move move, char* out) {
+    static constexpr char promotionPieces[] = { 0, 'n', 'b', 'r', 'q' };
+    if (move == InvalidMove) {
+        for (int i = 0; i < 4; i++) *out++ = '0';
+        return out;
+    }
+    *out++ = char('a' + moveFrom(move) % 8);
+    *out++ = char('1' + moveFrom(move) / 8);
+    *out++ = char('a' + moveTo(move) % 8);
+    *out++ = char('1' + moveTo(move) / 8);
+    if (movePromotion(move) != NoPromotion) *out++ = promotionPieces[movePromotion(move)];
+    return out;
+}
+
+inline std::string moveToUci(Move move) {
+    char uci[5];
+    return std::string(uci, writeUci(move, uci));
+}
+
+// The move in UCI notation as a Move, or InvalidMove. Game records leave the promotion piece out,
+// so a four-character pawn move onto the last rank stays NoPromotion (see isUnmarkedPromotion).
+inline Move parseUciMove(std::string_view text) {
+    if (text.size() != 4 && text.size() != 5) return InvalidMove;
+    for (int i = 0; i < 4; i += 2) {
+        if (text[i] < 'a' || text[i] > 'h' || text[i + 1] < '1' || text[i + 1] > '8') return InvalidMove;
+    }
+    int promotion = NoPromotion;
+    if (text.size() == 5) {
+        switch (text[4]) {
+        case 'n': promotion = PromoteKnight; break;
+        case 'b': promotion = PromoteBishop; break;
+        case 'r': promotion = PromoteRook; break;
+        case 'q': promotion = PromoteQueen; break;
+        default: return InvalidMove;
+        }
+    }
+    return encodeMove((text[1] - '1') * 8 + (text[0] - 'a'), (text[3] - '1') * 8 + (text[2] - 'a'), promotion);
+}
+
+// Random keys for Zobrist hashing. They come from a fixed seed and must never change:
+// hashes are stored on disk by the evaluation cache.
+struct ZobristKeys {
+    uint64_t pieces[2][PieceTypeCount][64];
+    uint64_t castling[16];    // indexed by the castling rights as bits: K = 1, Q = 2, k = 4, q = 8
+    uint64_t enPassantFile[8];
+    uint64_t blackToMove;
+
+    ZobristKeys() {
+        uint64_t state = 0x9E3779B97F4A7C15ULL;
+        auto next = [&state]() { // splitmix64
+            uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+            return z ^ (z >> 31);
+        };
+
+        for (auto& color : pieces) {
+            for (auto& type : color) {
+                for (auto& key : type) key = next();
+            }
+        }
+        for (auto& key : castling) key = next();
+        for (auto& key : enPassantFile) key = next();
+        blackToMove = next();
+    }
+};
+
+inline const ZobristKeys zobristKeys;
+
+// What unmakeMove needs to take a move back: the state makeMove overwrites and cannot recompute.
+struct UndoInfo {
+    uint64_t hashKey;
+    int32_t halfmoveClock;
+    int32_t fullmoveNumber;
+    uint8_t from;
+    uint8_t to;
+    char moved;             // the piece that moved, before any promotion
+    char captured;          // '.' if the move captured nothing
+    uint8_t castlingRights; // as bits, see castlingRights()
+    int8_t enPassantFile;
+    bool enPassant;         // the capture was en passant; the captured pawn stood beside `from`
+};
+
+class ChessPosition {
+private:
+    std::array<std::array<char, 8>, 8> board;
+    bool whiteToMove = true;
+    bool whiteKingSideCastle = true;
+    bool whiteQueenSideCastle = true;
+    bool blackKingSideCastle = true;
+    bool blackQueenSideCastle = true;
+    int enPassantFile = -1; // -1 if no en passant possible
+    int halfmoveClock = 0;  // plies since the last capture or pawn move
+    int fullmoveNumber = 1;
+    uint64_t hashKey = 0;   // Zobrist hash, kept up to date by makeMove and unmakeMove
+    BoardBitboards pieceBitboards; // the board as bitboards, kept up to date by makeMove
+
+    void togglePiece(char piece, int rank, int file) {
+        int type = pieceTypeOf(piece);
+        if (type < 0) return;
+        int color = piece >= 'a' ? 1 : 0;
+        int square = rank * 8 + file;
+        hashKey ^= zobristKeys.pieces[color][type][square];
+        pieceBitboards.pieces[color][type] ^= squareBit(square);
+        pieceBitboards.byColor[color] ^= squareBit(square);
+        pieceBitboards.occupied ^= squareBit(square);
+        if (type == King) {
+            Bitboard kings = pieceBitboards.pieces[color][King];
+            pieceBitboards.kingSquare[color] = kings ? lowestSquare(kings) : -1;
+        }
+    }
+
+    // Every change to the board during a move goes through here, keeping the hash and bitboards in step.
+    void setSquare(int rank, int file, char piece) {
+        togglePiece(board[rank][file], rank, file);
+        board[rank][file] = piece;
+        togglePiece(piece, rank, file);
+    }
+
+    // Pawns of the side to move that can legally capture en passant. Rare enough to verify by
+    // replaying the capture on the occupancy, which also catches the case where both pawns leave
+    // a rank shared by the king and an enemy rook.
+    Bitboard enPassantCapturers(const BoardBitboards& bb) const {
+        if (enPassantFile < 0) return 0;
+
+        const int us = whiteToMove ? 0 : 1;
+        const int them = us ^ 1;
+        const int kingSquare = bb.kingSquare[us];
+        const int epSquare = (us == 0 ? 5 : 2) * 8 + enPassantFile;
+        const int capturedSquare = epSquare + (us == 0 ? -8 : 8);
+        if (kingSquare < 0 || !(bb.pieces[them][Pawn] & squareBit(capturedSquare)) || (bb.occupied & squareBit(epSquare))) {
+            return 0;
+        }
+
+        Bitboard capturers = 0;
+        for (Bitboard b = attackTables.pawn[them][epSquare] & bb.pieces[us][Pawn]; b; b &= b - 1) {
+            int from = lowestSquare(b);
+            Bitboard after = (bb.occupied ^ squareBit(from) ^ squareBit(capturedSquare)) | squareBit(epSquare);
+            if (!(bb.attackersTo(kingSquare, them, after) & ~squareBit(capturedSquare))) {
+                capturers |= squareBit(from);
+            }
+        }
+        return capturers;
+    }
+
+    // makeMove on board coordinates. `promotion` is the UCI promotion letter, or 0 when the move has none.
+    bool applyMove(int fromRank, int fromFile, int toRank, int toFile, char promotion) {
+        char piece = board[fromRank][fromFile];
+        if (piece == '.') return false;
+
+        // Clocks: any capture or pawn move resets the fifty-move counter
+        bool isPawnMove = piece == 'P' || piece == 'p';
+        bool isCapture = board[toRank][toFile] != '.' || (isPawnMove && fromFile != toFile);
+        halfmoveClock = (isPawnMove || isCapture) ? 0 : halfmoveClock + 1;
+        if (!whiteToMove) fullmoveNumber++;
+
+        // Hash: take out the castling and en passant state now, the new state goes back in at the end
+        hashKey ^= zobristKeys.castling[castlingRights()];
+        if (enPassantPossible()) hashKey ^= zobristKeys.enPassantFile[enPassantFile];
+
+        // Handle en passant capture
+        if ((piece == 'P' || piece == 'p') && toFile == enPassantFile &&
+            ((piece == 'P' && fromRank == 4 && toRank == 5) ||
+                (piece == 'p' && fromRank == 3 && toRank == 2))) {
+            // En passant capture
+            int capturedPawnRank = piece == 'P' ? 4 : 3;
+            setSquare(capturedPawnRank, toFile, '.');
+        }
+
+        // Set en passant flag for next move
+        enPassantFile = -1;
+        if ((piece == 'P' && fromRank == 1 && toRank == 3) ||
+            (piece == 'p' && fromRank == 6 && toRank == 4)) {
+            enPassantFile = fromFile;
+        }
+
+        // Handle castling
+        if (piece == 'K' && fromFile == 4 && fromRank == 0) {
+            if (toFile == 6 && toRank == 0) { // King-side castling
+                setSquare(0, 5, board[0][7]); // Move rook
+                setSquare(0, 7, '.');
+            }
+            else if (toFile == 2 && toRank == 0) { // Queen-side castling
+                setSquare(0, 3, board[0][0]); // Move rook
+                setSquare(0, 0, '.');
+            }
+            whiteKingSideCastle = whiteQueenSideCastle = false;
+        }
+        else if (piece == 'k' && fromFile == 4 && fromRank == 7) {
+            if (toFile == 6 && toRank == 7) { // King-side castling
+                setSquare(7, 5, board[7][7]); // Move rook
+                setSquare(7, 7, '.');
+            }
+            else if (toFile == 2 && toRank == 7) { // Queen-side castling
+                setSquare(7, 3, board[7][0]); // Move rook
+                setSquare(7, 0, '.');
+            }
+            blackKingSideCastle = blackQueenSideCastle = false;
+        }
+
+        // Update castling rights
+        if (piece == 'K') whiteKingSideCastle = whiteQueenSideCastle = false;
+        if (piece == 'k') blackKingSideCastle = blackQueenSideCastle = false;
+        if (piece == 'R') {
+            if (fromFile == 0 && fromRank == 0) whiteQueenSideCastle = false;
+            if (fromFile == 7 && fromRank == 0) whiteKingSideCastle = false;
+        }
+        if (piece == 'r') {
+            if (fromFile == 0 && fromRank == 7) blackQueenSideCastle = false;
+            if (fromFile == 7 && fromRank == 7) blackKingSideCastle = false;
+        }
+        // A rook captured on its home square takes its castling right with it
+        if (toRank == 0 && toFile == 0) whiteQueenSideCastle = false;
+        if (toRank == 0 && toFile == 7) whiteKingSideCastle = false;
+        if (toRank == 7 && toFile == 0) blackQueenSideCastle = false;
+        if (toRank == 7 && toFile == 7) blackKingSideCastle = false;
+
+        // Handle promotion
+        char promotionPiece = piece;
+        if (promotion) {
+            if (piece == 'P') {
+                switch (promotion) {
+                case 'q': promotionPiece = 'Q'; break;
+                case 'r': promotionPiece = 'R'; break;
+                case 'b': promotionPiece = 'B'; break;
+                case 'n': promotionPiece = 'N'; break;
+                }
+            }
+            else if (piece == 'p') {
+                switch (promotion) {
+                case 'q': promotionPiece = 'q'; break;
+                case 'r': promotionPiece = 'r'; break;
+                case 'b': promotionPiece = 'b'; break;
+                case 'n': promotionPiece = 'n'; break;
+                }
+            }
+        }
+        else if ((piece == 'P' && toRank == 7) || (piece == 'p' && toRank == 0)) {
+            // The game records leave the promotion piece out; the site auto-queens
+            promotionPiece = piece == 'P' ? 'Q' : 'q';
+        }
+
+        // Make the move
+        setSquare(fromRank, fromFile, '.');
+        setSquare(toRank, toFile, promotionPiece);
+
+        whiteToMove = !whiteToMove;
+
+        hashKey ^= zobristKeys.blackToMove;
+        hashKey ^= zobristKeys.castling[castlingRights()];
+        if (enPassantPossible()) hashKey ^= zobristKeys.enPassantFile[enPassantFile];
+        return true;
+    }
+
+public:
+    ChessPosition() {
+        // Initialize starting position
+        resetToStartingPosition();
+    }
+
+    void resetToStartingPosition() {
+        // Initialize empty board
+        for (int i = 0; i < 8; i++) {
+            for (int j = 0; j < 8; j++) {
+                board[i][j] = '.';
+            }
+        }
+
+        // Set up starting position
+        // White pieces
+        board[0][0] = 'R'; board[0][1] = 'N'; board[0][2] = 'B'; board[0][3] = 'Q';
+        board[0][4] = 'K'; board[0][5] = 'B'; board[0][6] = 'N'; board[0][7] = 'R';
+        for (int i = 0; i < 8; i++) board[1][i] = 'P';
+
+        // Black pieces
+        board[7][0] = 'r'; board[7][1] = 'n'; board[7][2] = 'b'; board[7][3] = 'q';
+        board[7][4] = 'k'; board[7][5] = 'b'; board[7][6] = 'n'; board[7][7] = 'r';
+        for (int i = 0; i < 8; i++) board[6][i] = 'p';
+
+        whiteToMove = true;
+        whiteKingSideCastle = blackKingSideCastle = true;
+        whiteQueenSideCastle = blackQueenSideCastle = true;
+        enPassantFile = -1;
+        halfmoveClock = 0;
+        fullmoveNumber = 1;
+        pieceBitboards = computeBitboards();
+        hashKey = computeHash();
+    }
+
+    // Sets up the position described by `fen`. The move counters may be left out.
+    // Returns false, leaving the position unchanged, if the FEN is malformed.
+    bool setFen(std::string_view fen) {
+        auto nextField = [&fen]() {
+            size_t start = fen.find_first_not_of(' ');
+            if (start == std::string_view::npos) return std::string_view();
+            fen.remove_prefix(start);
+            std::string_view field = fen.substr(0, fen.find(' '));
+            fen.remove_prefix(field.size());
+            return field;
+        };
+
+        std::array<std::array<char, 8>, 8> placement;
+        for (auto& rank : placement) rank.fill('.');
+
+        int rank = 7;
+        int file = 0;
+        for (char c : nextField()) {
+            if (c == '/') {
+                if (file != 8 || rank == 0) return false;
+                rank--;
+                file = 0;
+            }
+            else if (c >= '1' && c <= '8') {
+                file += c - '0';
+                if (file > 8) return false;
+            }
+            else if (pieceTypeOf(c) >= 0 && file < 8) {
+                placement[rank][file++] = c;
+            }
+            else {
+                return false;
+            }
+        }
+        if (rank != 0 || file != 8) return false;
+
+        std::string_view side = nextField();
+        if (side != "w" && side != "b") return false;
+
+        std::string_view castling = nextField();
+        if (castling.empty() || castling.find_first_not_of(castling == "-" ? "-" : "KQkq") != std::string_view::npos) return false;
+
+        std::string_view enPassant = nextField();
+        int epFile = -1;
+        if (enPassant.size() == 2 && enPassant[0] >= 'a' && enPassant[0] <= 'h' && (enPassant[1] == '3' || enPassant[1] == '6')) {
+            epFile = enPassant[0] - 'a';
+        }
+        else if (enPassant != "-") {
+            return false;
+        }
+
+        int halfmoves = 0;
+        int fullmoves = 1;
+        std::string_view field = nextField();
+        if (!field.empty() && std::from_chars(field.data(), field.data() + field.size(), halfmoves).ec != std::errc()) return false;
+        field = nextField();
+        if (!field.empty() && std::from_chars(field.data(), field.data() + field.size(), fullmoves).ec != std::errc()) return false;
+
+        board = placement;
+        whiteToMove = side == "w";
+        whiteKingSideCastle = castling.find('K') != std::string_view::npos;
+        whiteQueenSideCastle = castling.find('Q') != std::string_view::npos;
+        blackKingSideCastle = castling.find('k') != std::string_view::npos;
+        blackQueenSideCastle = castling.find('q') != std::string_view::npos;
+        enPassantFile = epFile;
+        halfmoveClock = halfmoves;
+        fullmoveNumber = fullmoves;
+        pieceBitboards = computeBitboards();
+        hashKey = computeHash();
+        return true;
+    }
+
+    bool isWhiteToMove() const {
+        return whiteToMove;
+    }
+
+    std::pair<int, int> findKing(bool isWhite) const {
+        int square = pieceBitboards.kingSquare[isWhite ? 0 : 1];
+        if (square < 0) return { -1, -1 }; // Should never happen in valid position
+        return { square / 8, square % 8 };
+    }
+
+    // The piece on a square ('.' if empty), rank and file counted from 0.
+    char pieceAt(int rank, int file) const {
+        return board[rank][file];
+    }
+
+    bool isSquareAttacked(int rank, int file, bool byWhite) const {
+        return pieceBitboards.attackersTo(rank * 8 + file, byWhite ? 0 : 1, pieceBitboards.occupied) != 0;
+    }
+
+    bool isInCheck(bool isWhiteKing) const {
+        int square = pieceBitboards.kingSquare[isWhiteKing ? 0 : 1];
+        if (square < 0) return false; // No king found
+
+        return pieceBitboards.attackersTo(square, isWhiteKing ? 1 : 0, pieceBitboards.occupied) != 0;
+    }
+
+    bool makeMove(const std::string& move) {
+        if (move.length() < 4) return false;
+
+        int fromFile = move[0] - 'a';
+        int fromRank = move[1] - '1';
+        int toFile = move[2] - 'a';
+        int toRank = move[3] - '1';
+
+        if (fromFile < 0 || fromFile > 7 || fromRank < 0 || fromRank > 7 ||
+            toFile < 0 || toFile > 7 || toRank < 0 || toRank > 7) {
+            return false;
+        }
+
+        return applyMove(fromRank, fromFile, toRank, toFile, move.length() == 5 ? move[4] : 0);
+    }
+
+    // A move from generateLegalMoves or parseUciMove, without going through its UCI string.
+    // InvalidMove is rejected like a malformed string.
+    bool makeMove(Move move) {
+        static constexpr char promotionPieces[] = { 0, 'n', 'b', 'r', 'q' };
+        if (move == InvalidMove) return false;
+        int from = moveFrom(move);
+        int to = moveTo(move);
+        return applyMove(from / 8, from % 8, to / 8, to % 8, promotionPieces[movePromotion(move)]);
+    }
+
+    // Same as above, first recording in `undo` what unmakeMove needs to take the move back. A rejected
+    // move leaves both the position and `undo` untouched, and there is nothing to take back.
+    bool makeMove(Move move, UndoInfo& undo) {
+        if (move == InvalidMove) return false;
+        int from = moveFrom(move);
+        int to = moveTo(move);
+        char piece = board[from / 8][from % 8];
+        if (piece == '.') return false; // what applyMove rejects, checked before `undo` is written
+
+        undo.hashKey = hashKey;
+        undo.halfmoveClock = halfmoveClock;
+        undo.fullmoveNumber = fullmoveNumber;
+        undo.from = static_cast<uint8_t>(from);
+        undo.to = static_cast<uint8_t>(to);
+        undo.moved = piece;
+        // A pawn moving diagonally onto an empty square captures en passant
+        undo.enPassant = (piece == 'P' || piece == 'p') && from % 8 != to % 8 && board[to / 8][to % 8] == '.';
+        undo.captured = undo.enPassant ? board[from / 8][to % 8] : board[to / 8][to % 8];
+        undo.castlingRights = static_cast<uint8_t>(castlingRights());
+        undo.enPassantFile = static_cast<int8_t>(enPassantFile);
+        return makeMove(move);
+    }
+
+    // Takes back the move `undo` was recorded for, which must be the last move made. Restores the
+    // position exactly, hash and bitboards included.
+    void unmakeMove(const UndoInfo& undo) {
+        int fromRank = undo.from / 8;
+        int fromFile = undo.from % 8;
+        int toRank = undo.to / 8;
+        int toFile = undo.to % 8;
+
+        // Castling also moved the rook
+        if ((undo.moved == 'K' || undo.moved == 'k') && fromFile == 4 && fromRank == (undo.moved == 'K' ? 0 : 7) &&
+            toRank == fromRank && (toFile == 6 || toFile == 2)) {
+            int rookHome = toFile == 6 ? 7 : 0;
+            int rookCastled = toFile == 6 ? 5 : 3;
+            setSquare(fromRank, rookHome, board[fromRank][rookCastled]);
+            setSquare(fromRank, rookCastled, '.');
+        }
+
+        if (undo.enPassant) {
+            setSquare(toRank, toFile, '.');
+            setSquare(fromRank, toFile, undo.captured);
+        }
+        else {
+            setSquare(toRank, toFile, undo.captured);
+        }
+        setSquare(fromRank, fromFile, undo.moved);
+
+        whiteToMove = !whiteToMove;
+        whiteKingSideCastle = (undo.castlingRights & 1) != 0;
+        whiteQueenSideCastle = (undo.castlingRights & 2) != 0;
+        blackKingSideCastle = (undo.castlingRights & 4) != 0;
+        blackQueenSideCastle = (undo.castlingRights & 8) != 0;
+        enPassantFile = undo.enPassantFile;
+        halfmoveClock = undo.halfmoveClock;
+        fullmoveNumber = undo.fullmoveNumber;
+        hashKey = undo.hashKey;
+    }
+
+    // Exact comparison of the whole state, hash and bitboards included.
+    bool operator==(const ChessPosition&) const = default;
+
+    int getHalfmoveClock() const {
+        return halfmoveClock;
+    }
+
+    // True for a pawn move onto the last rank with no promotion piece, which makeMove treats as a queen promotion.
+    // The engine rejects such moves, so callers append the 'q' before sending them.
+    bool isUnmarkedPromotion(Move move) const {
+        if (move == InvalidMove || movePromotion(move) != NoPromotion) return false;
+        char piece = board[moveFrom(move) / 8][moveFrom(move) % 8];
+        return (piece == 'P' && moveTo(move) / 8 == 7) || (piece == 'p' && moveTo(move) / 8 == 0);
+    }
+
+    bool kingSideCastle() {
+        return whiteToMove ? whiteKingSideCastle : blackKingSideCastle;
+    }
+
+    bool queenSideCastle() {
+        return whiteToMove ? whiteQueenSideCastle : blackQueenSideCastle;
+    }
+
+    static constexpr int MaxMoves = 256;
+    static constexpr size_t FenBufferSize = 128; // longest legal FEN is under 100 characters
+
+    // Writes the position as a NUL-terminated FEN into `out` (at least FenBufferSize bytes) and
+    // returns its length. Like Stockfish, the en passant square is only given when the capture is legal.
+    size_t writeFen(char* out) const {
+        char* p = out;
+        for (int rank = 7; rank >= 0; rank--) {
+            int empty = 0;
+            for (int file = 0; file < 8; file++) {
+                char piece = board[rank][file];
+                if (piece == '.') {
+                    empty++;
+                    continue;
+                }
+                if (empty) *p++ = static_cast<char>('0' + empty);
+                empty = 0;
+                *p++ = piece;
+            }
+            if (empty) *p++ = static_cast<char>('0' + empty);
+            if (rank > 0) *p++ = '/';
+        }
+
+        *p++ = ' ';
+        *p++ = whiteToMove ? 'w' : 'b';
+        *p++ = ' ';
+
+        char* castling = p;
+        if (whiteKingSideCastle) *p++ = 'K';
+        if (whiteQueenSideCastle) *p++ = 'Q';
+        if (blackKingSideCastle) *p++ = 'k';
+        if (blackQueenSideCastle) *p++ = 'q';
+        if (p == castling) *p++ = '-';
+        *p++ = ' ';
+
+        if (enPassantFile >= 0 && enPassantCapturers(pieceBitboards)) {
+            *p++ = static_cast<char>('a' + enPassantFile);
+            *p++ = whiteToMove ? '6' : '3';
+        }
+        else {
+            *p++ = '-';
+        }
+
+        *p++ = ' ';
+        p = std::to_chars(p, out + FenBufferSize - 2, halfmoveClock).ptr; // leaves room for ' ' and the NUL
+        *p++ = ' ';
+        p = std::to_chars(p, out + FenBufferSize - 1, fullmoveNumber).ptr;
+        *p = '\0';
+        return static_cast<size_t>(p - out);
+    }
+
+    // Same as above, reusing the string's storage; no allocation once it has grown to FenBufferSize.
+    void writeFen(std::string& out) const {
+        out.resize(FenBufferSize);
+        out.resize(writeFen(out.data()));
+    }
+
+    int castlingRights() const {
+        return (whiteKingSideCastle ? 1 : 0) | (whiteQueenSideCastle ? 2 : 0) |
+            (blackKingSideCastle ? 4 : 0) | (blackQueenSideCastle ? 8 : 0);
+    }
+
+    // Whether the side to move has a pawn next to the pawn that just advanced two squares. The hash only
+    // includes the en passant file then, so positions that differ only by an unusable en passant right match.
+    bool enPassantPossible() const {
+        if (enPassantFile < 0) return false;
+        int rank = whiteToMove ? 4 : 3;
+        char pawn = whiteToMove ? 'P' : 'p';
+        return (enPassantFile > 0 && board[rank][enPassantFile - 1] == pawn) ||
+            (enPassantFile < 7 && board[rank][enPassantFile + 1] == pawn);
+    }
+
+    // Zobrist hash of the position, maintained incrementally.
+    uint64_t hash() const {
+        return hashKey;
+    }
+
+    // The same hash computed from scratch, to verify the incremental one: pieces, side to move,
+    // castling rights and usable en passant file.
+    uint64_t computeHash() const {
+        uint64_t key = 0;
+        for (int rank = 0; rank < 8; rank++) {
+            for (int file = 0; file < 8; file++) {
+                char piece = board[rank][file];
+                int type = pieceTypeOf(piece);
+                if (type >= 0) key ^= zobristKeys.pieces[piece >= 'a' ? 1 : 0][type][rank * 8 + file];
+            }
+        }
+        key ^= zobristKeys.castling[castlingRights()];
+        if (enPassantPossible()) key ^= zobristKeys.enPassantFile[enPassantFile];
+        if (!whiteToMove) key ^= zobristKeys.blackToMove;
+        return key;
+    }
+
+    // The bitboard view of the current board, maintained incrementally.
+    const BoardBitboards& bitboards() const {
+        return pieceBitboards;
+    }
+
+    // The same bitboards built from the board from scratch, to verify the incremental ones.
+    BoardBitboards computeBitboards() const {
+        BoardBitboards bb;
+        for (int rank = 0; rank < 8; rank++) {
+            for (int file = 0; file < 8; file++) {
+                char piece = board[rank][file];
+                if (piece == '.') continue;
+
+                int color = (piece >= 'a') ? 1 : 0;
+                int type = pieceTypeOf(piece);
+                if (type < 0) continue;
+
+                int square = rank * 8 + file;
+                bb.pieces[color][type] |= squareBit(square);
+                bb.byColor[color] |= squareBit(square);
+                if (type == King) bb.kingSquare[color] = square;
+            }
+        }
+        bb.occupied = bb.byColor[0] | bb.byColor[1];
+        return bb;
+    }
+
+    // Writes every legal move for the side to move into `moves` (room for MaxMoves) and returns how many there are.
+    int generateLegalMoves(Move* moves) const {
+        const BoardBitboards& bb = pieceBitboards;
+        const int us = whiteToMove ? 0 : 1;
+        const int them = us ^ 1;
+        const int kingSquare = bb.kingSquare[us];
+        if (kingSquare < 0) return 0;
+
+        const Bitboard ours = bb.byColor[us];
+        const Bitboard theirs = bb.byColor[them];
+        const Bitboard occupied = bb.occupied;
+        const Bitboard* enemy = bb.pieces[them];
+        int count = 0;
+
+        // King moves: the king is lifted off the board so it cannot hide behind itself on a slider's ray.
+        const Bitboard checkers = bb.attackersTo(kingSquare, them, occupied);
+        const Bitboard withoutKing = occupied ^ squareBit(kingSquare);
+        for (Bitboard targets = attackTables.king[kingSquare] & ~ours; targets; targets &= targets - 1) {
+            int to = lowestSquare(targets);
+            if (!bb.attackersTo(to, them, withoutKing)) moves[count++] = encodeMove(kingSquare, to);
+        }
+
+        // In double check only the king may move.
+        if (std::popcount(checkers) > 1) return count;
+
+        // In single check every other move has to capture the checker or block its ray.
+        Bitboard checkMask = ~Bitboard(0);
+        if (checkers) {
+            int checker = lowestSquare(checkers);
+            checkMask = attackTables.between[kingSquare][checker] | checkers;
+        }
+
+        // A piece is pinned when it is the only piece between the king and an enemy slider.
+        Bitboard pinned = 0;
+        Bitboard snipers = (attackTables.rookAttacks(kingSquare, theirs) & (enemy[Rook] | enemy[Queen])) |
+            (attackTables.bishopAttacks(kingSquare, theirs) & (enemy[Bishop] | enemy[Queen]));
+        for (; snipers; snipers &= snipers - 1) {
+            Bitboard blockers = attackTables.between[kingSquare][lowestSquare(snipers)] & occupied;
+            if (std::popcount(blockers) == 1 && (blockers & ours)) pinned |= blockers;
+        }
+
+        auto legalTargets = [&](int from, Bitboard targets) {
+            targets &= ~ours & checkMask;
+            if (pinned & squareBit(from)) targets &= attackTables.line[kingSquare][from];
+            return targets;
+        };
+        auto addMoves = [&](int from, Bitboard targets) {
+            for (; targets; targets &= targets - 1) moves[count++] = encodeMove(from, lowestSquare(targets));
+        };
+
+        const Bitboard* own = bb.pieces[us];
+        for (Bitboard b = own[Knight] & ~pinned; b; b &= b - 1) {
+            int from = lowestSquare(b);
+            addMoves(from, legalTargets(from, attackTables.knight[from]));
+        }
+        for (Bitboard b = own[Bishop] | own[Queen]; b; b &= b - 1) {
+            int from = lowestSquare(b);
+            addMoves(from, legalTargets(from, attackTables.bishopAttacks(from, occupied)));
+        }
+        for (Bitboard b = own[Rook] | own[Queen]; b; b &= b - 1) {
+            int from = lowestSquare(b);
+            addMoves(from, legalTargets(from, attackTables.rookAttacks(from, occupied)));
+        }
+
+        // Pawns
+        const int forward = us == 0 ? 8 : -8;
+        const int startRank = us == 0 ? 1 : 6;
+        const int lastRank = us == 0 ? 7 : 0;
+        for (Bitboard b = own[Pawn]; b; b &= b - 1) {
+            int from = lowestSquare(b);
+            Bitboard targets = attackTables.pawn[us][from] & theirs;
+
+            int oneStep = from + forward;
+            if (!(occupied & squareBit(oneStep))) {
+                targets |= squareBit(oneStep);
+                int twoSteps = oneStep + forward;
+                if (from / 8 == startRank && !(occupied & squareBit(twoSteps))) targets |= squareBit(twoSteps);
+            }
+
+            for (targets = legalTargets(from, targets); targets; targets &= targets - 1) {
+                int to = lowestSquare(targets);
+                if (to / 8 == lastRank) {
+                    for (int promotion = PromoteQueen; promotion >= PromoteKnight; promotion--) {
+                        moves[count++] = encodeMove(from, to, promotion);
+                    }
+                }
+                else {
+                    moves[count++] = encodeMove(from, to);
+                }
+            }
+        }
+
+        if (enPassantFile >= 0) {
+            int epSquare = (us == 0 ? 5 : 2) * 8 + enPassantFile;
+            for (Bitboard b = enPassantCapturers(bb); b; b &= b - 1) {
+                moves[count++] = encodeMove(lowestSquare(b), epSquare);
+            }
+        }
+
+        // Castling: the rights must still be held, the rook must still be home and the king may not
+        // start in, pass through or land on an attacked square.
+        const int homeRank = us == 0 ? 0 : 7;
+        const char ownRook = us == 0 ? 'R' : 'r';
+        const bool canKingSide = us == 0 ? whiteKingSideCastle : blackKingSideCastle;
+        const bool canQueenSide = us == 0 ? whiteQueenSideCastle : blackQueenSideCastle;
+        if (!checkers && kingSquare == homeRank * 8 + 4) {
+            int e = homeRank * 8 + 4;
+            if (canKingSide && board[homeRank][7] == ownRook &&
+                !(occupied & (squareBit(e + 1) | squareBit(e + 2))) &&
+                !bb.attackersTo(e + 1, them, occupied) && !bb.attackersTo(e + 2, them, occupied)) {
+                moves[count++] = encodeMove(e, e + 2);
+            }
+            if (canQueenSide && board[homeRank][0] == ownRook &&
+                !(occupied & (squareBit(e - 1) | squareBit(e - 2) | squareBit(e - 3))) &&
+                !bb.attackersTo(e - 1, them, occupied) && !bb.attackersTo(e - 2, them, occupied)) {
+                moves[count++] = encodeMove(e, e - 2);
+            }
+        }
+
+        return count;
+    }
+
+    int countLegalMoves() const {
+        Move moves[MaxMoves];
+        return generateLegalMoves(moves);
+    }
+};
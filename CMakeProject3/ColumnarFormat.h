@@ -0,0 +1,114 @@
+﻿// ColumnarFormat.h : On-disk layout of the columnar ply dataset, shared by its writer and reader.
+
+#pragma once
+
+#include <cstdint>
+
+// A file is a FileHeader followed by self-contained chunks, each a ChunkHeader and its columns.
+// There is no global footer, so a file can be appended to and a torn last chunk is simply ignored.
+// Everything is little-endian and 8-byte aligned, so mapped columns can be used in place.
+//
+// The FENs are dictionary-encoded per chunk: FenBefore and FenAfter hold indices into the
+// FenText bytes, where string i spans [FenOffsets[i], FenOffsets[i + 1]).
+//
+// Moves are the 16-bit codes of Bitboard.h, InvalidMove where there is none. Row r's principal
+// variation is PvMoves[PvOffsets[r]] up to PvMoves[PvOffsets[r + 1]]. Mate is 0 when the search
+// found no mate; SelDepth through PvMoves are 0 or empty for plies answered from the cache.
+struct ColumnarFormat {
+    static constexpr char FileMagic[8] = { 'P', 'L', 'Y', 'C', 'O', 'L', 'S', '1' };
+    static constexpr uint32_t Version = 3; // 2 added SearchDepth, 3 Mate through PvMoves
+    static constexpr uint32_t ChunkMagic = 0x4B4E4843; // "CHNK"
+    static constexpr uint64_t Alignment = 8;
+
+    enum Column : uint32_t {
+        Ply,
+        KingSideCastle,
+        QueenSideCastle,
+        CheckBefore,
+        CheckAfter,
+        EvalDelta,
+        EvalBefore,
+        EvalAfter,
+        TimeRemaining,
+        TimeSpentOnMoveBeforeIt,
+        LegalMovesBefore,
+        LegalMovesAfter,
+        TimeSpent,
+        FenBefore,
+        FenAfter,
+        SearchDepth,
+        Mate,
+        SelDepth,
+        Nodes,
+        Nps,
+        BestMove,
+        FenOffsets,
+        FenText,
+        PvOffsets,
+        PvMoves,
+        ColumnCount
+    };
+
+    enum ColumnType : uint32_t {
+        UInt8,
+        UInt32,
+        Float64,
+        Bytes,
+        Int8,
+        UInt16,
+        UInt64
+    };
+
+    static constexpr ColumnType columnType(Column column) {
+        switch (column) {
+        case Ply: case FenBefore: case FenAfter: case FenOffsets: case PvOffsets:
+            return UInt32;
+        case KingSideCastle: case QueenSideCastle: case CheckBefore: case CheckAfter:
+        case LegalMovesBefore: case LegalMovesAfter: case SearchDepth: case SelDepth:
+            return UInt8;
+        case Mate:
+            return Int8;
+        case BestMove: case PvMoves:
+            return UInt16;
+        case Nodes: case Nps:
+            return UInt64;
+        case FenText:
+            return Bytes;
+        default:
+            return Float64;
+        }
+    }
+
+    struct FileHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t reserved;
+    };
+
+    // `offset` is relative to the start of the chunk. min and max cover the column's values
+    // (for the dictionary columns, the indices and offsets) and are 0 for FenText.
+    struct ColumnInfo {
+        uint32_t type;
+        uint32_t column;
+        uint64_t offset;
+        uint64_t size;
+        double min;
+        double max;
+    };
+
+    struct ChunkHeader {
+        uint32_t magic;
+        uint32_t rowCount;
+        uint64_t chunkSize; // header and columns, padded to Alignment
+        uint32_t columnCount;
+        uint32_t fenCount;
+        ColumnInfo columns[ColumnCount];
+    };
+
+    static constexpr uint64_t align(uint64_t size) {
+        return (size + Alignment - 1) & ~(Alignment - 1);
+    }
+};
+
+static_assert(sizeof(ColumnarFormat::FileHeader) % ColumnarFormat::Alignment == 0);
+static_assert(sizeof(ColumnarFormat::ChunkHeader) % ColumnarFormat::Alignment == 0);
@@ -0,0 +1,152 @@
+﻿// ColumnarReader.h : Maps a columnar ply dataset and exposes its chunks' columns in place.
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include "ColumnarFormat.h"
+#include "MappedFile.h"
+
+// Columns are returned as spans straight into the mapping, so nothing is parsed or copied.
+// A torn chunk at the end of the file (from an interrupted run) is ignored.
+class ColumnarReader {
+public:
+    using Format = ColumnarFormat;
+
+    class Chunk {
+    private:
+        const char* base;
+        const Format::ChunkHeader* header;
+
+        template <typename T>
+        static constexpr bool matches(uint32_t type) {
+            switch (type) {
+            case Format::UInt8: return std::is_same_v<T, uint8_t>;
+            case Format::UInt32: return std::is_same_v<T, uint32_t>;
+            case Format::Float64: return std::is_same_v<T, double>;
+            case Format::Bytes: return std::is_same_v<T, char>;
+            case Format::Int8: return std::is_same_v<T, int8_t>;
+            case Format::UInt16: return std::is_same_v<T, uint16_t>;
+            case Format::UInt64: return std::is_same_v<T, uint64_t>;
+            }
+            return false;
+        }
+
+    public:
+        explicit Chunk(const char* base)
+            : base(base), header(reinterpret_cast<const Format::ChunkHeader*>(base)) {
+        }
+
+        uint32_t rowCount() const {
+            return header->rowCount;
+        }
+
+        uint64_t byteSize() const {
+            return header->chunkSize;
+        }
+
+        const Format::ColumnInfo& info(Format::Column column) const {
+            return header->columns[column];
+        }
+
+        // Chunk statistics, e.g. to skip chunks whose values are all out of range.
+        double min(Format::Column column) const {
+            return info(column).min;
+        }
+
+        double max(Format::Column column) const {
+            return info(column).max;
+        }
+
+        // The column's values; empty if `T` is not the column's stored type.
+        template <typename T>
+        std::span<const T> column(Format::Column column) const {
+            const Format::ColumnInfo& c = info(column);
+            if (!matches<T>(c.type)) return {};
+            return { reinterpret_cast<const T*>(base + c.offset), static_cast<size_t>(c.size / sizeof(T)) };
+        }
+
+        // Resolves a FenBefore / FenAfter index.
+        std::string_view fen(uint32_t index) const {
+            std::span<const uint32_t> offsets = column<uint32_t>(Format::FenOffsets);
+            std::span<const char> text = column<char>(Format::FenText);
+            if (index + 1 >= offsets.size()) return {};
+            return std::string_view(text.data() + offsets[index], offsets[index + 1] - offsets[index]);
+        }
+
+        // Row `row`'s principal variation, as move codes.
+        std::span<const uint16_t> pv(uint32_t row) const {
+            std::span<const uint32_t> offsets = column<uint32_t>(Format::PvOffsets);
+            std::span<const uint16_t> moves = column<uint16_t>(Format::PvMoves);
+            if (row + 1 >= offsets.size()) return {};
+            return moves.subspan(offsets[row], offsets[row + 1] - offsets[row]);
+        }
+    };
+
+private:
+    MappedFile file;
+    std::vector<Chunk> chunkList;
+    uint64_t totalRows = 0;
+
+    bool validChunk(const char* base, uint64_t available) const {
+        if (available < sizeof(Format::ChunkHeader)) return false;
+        const auto* header = reinterpret_cast<const Format::ChunkHeader*>(base);
+        if (header->magic != Format::ChunkMagic || header->columnCount != Format::ColumnCount) return false;
+        if (header->chunkSize < sizeof(Format::ChunkHeader) || header->chunkSize > available) return false;
+        if (header->chunkSize % Format::Alignment != 0) return false;
+
+        for (uint32_t c = 0; c < Format::ColumnCount; c++) {
+            const Format::ColumnInfo& info = header->columns[c];
+            if (info.offset % Format::Alignment != 0 || info.offset > header->chunkSize ||
+                info.size > header->chunkSize - info.offset) return false;
+        }
+
+        // Both offset columns must be ascending and end inside the column they index
+        auto validOffsets = [&](Format::Column offsetColumn, uint64_t count, Format::Column dataColumn, uint64_t elementSize) {
+            const Format::ColumnInfo& offsets = header->columns[offsetColumn];
+            if (offsets.size != (count + 1) * sizeof(uint32_t)) return false;
+            const auto* values = reinterpret_cast<const uint32_t*>(base + offsets.offset);
+            for (uint64_t i = 0; i < count; i++) {
+                if (values[i] > values[i + 1]) return false;
+            }
+            return values[count] * elementSize <= header->columns[dataColumn].size;
+        };
+        return validOffsets(Format::FenOffsets, header->fenCount, Format::FenText, 1) &&
+            validOffsets(Format::PvOffsets, header->rowCount, Format::PvMoves, sizeof(uint16_t));
+    }
+
+public:
+    bool open(const std::string& path) {
+        chunkList.clear();
+        totalRows = 0;
+        if (!file.openReadOnly(path) || file.size() < sizeof(Format::FileHeader)) return false;
+
+        Format::FileHeader header;
+        std::memcpy(&header, file.data(), sizeof(header));
+        if (std::memcmp(header.magic, Format::FileMagic, sizeof(header.magic)) != 0 || header.version != Format::Version) {
+            return false;
+        }
+
+        uint64_t offset = sizeof(header);
+        while (offset < file.size() && validChunk(file.data() + offset, file.size() - offset)) {
+            chunkList.emplace_back(file.data() + offset);
+            totalRows += chunkList.back().rowCount();
+            offset += chunkList.back().byteSize();
+        }
+        return true;
+    }
+
+    const std::vector<Chunk>& chunks() const {
+        return chunkList;
+    }
+
+    uint64_t rowCount() const {
+        return totalRows;
+    }
+};
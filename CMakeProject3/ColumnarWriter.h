@@ -0,0 +1,178 @@
+﻿// ColumnarWriter.h : Encodes finished games into chunks of the columnar ply dataset.
+
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "AsyncGameWriter.h"
+#include "ColumnarFormat.h"
+
+// Rows are gathered column by column and written as one chunk once `chunkRows` rows are buffered
+// (games are never split between chunks). Every sync also closes the current chunk, so frequent
+// --sync-games checkpoints trade chunk size for durability.
+class ColumnarWriter : public AsyncGameWriter {
+private:
+    using Format = ColumnarFormat;
+
+    size_t chunkRows;
+    uint32_t rowCount = 0;
+    std::vector<char> columns[Format::ColumnCount];
+    double minimum[Format::ColumnCount];
+    double maximum[Format::ColumnCount];
+
+    std::unordered_map<std::string, uint32_t> fenIndex;
+    uint32_t lastFenAfter = 0;
+    std::vector<char> chunk;
+
+    template <typename T>
+    void append(Format::Column column, T value) {
+        std::vector<char>& data = columns[column];
+        size_t size = data.size();
+        data.resize(size + sizeof(T));
+        std::memcpy(data.data() + size, &value, sizeof(T));
+
+        double number = static_cast<double>(value);
+        minimum[column] = std::min(minimum[column], number);
+        maximum[column] = std::max(maximum[column], number);
+    }
+
+    static uint8_t toUInt8(double value) {
+        return static_cast<uint8_t>(std::clamp(value, 0.0, 255.0));
+    }
+
+    uint32_t internFen(const char* fen) {
+        auto [it, inserted] = fenIndex.try_emplace(fen, static_cast<uint32_t>(fenIndex.size()));
+        if (inserted) {
+            std::vector<char>& text = columns[Format::FenText];
+            text.insert(text.end(), fen, fen + std::strlen(fen));
+            append(Format::FenOffsets, static_cast<uint32_t>(text.size()));
+        }
+        return it->second;
+    }
+
+    void resetChunk() {
+        rowCount = 0;
+        for (uint32_t c = 0; c < Format::ColumnCount; c++) {
+            columns[c].clear();
+            minimum[c] = std::numeric_limits<double>::infinity();
+            maximum[c] = -std::numeric_limits<double>::infinity();
+        }
+        fenIndex.clear();
+        append(Format::FenOffsets, uint32_t(0));
+        append(Format::PvOffsets, uint32_t(0));
+    }
+
+    void appendRow(const PlyRow& row, const PlyRow* previous) {
+        append(Format::Ply, row.ply);
+        append(Format::KingSideCastle, uint8_t(row.kingSideCastle));
+        append(Format::QueenSideCastle, uint8_t(row.queenSideCastle));
+        append(Format::CheckBefore, uint8_t(row.checkBefore));
+        append(Format::CheckAfter, uint8_t(row.checkAfter));
+        append(Format::EvalDelta, row.evalAfter - row.evalBefore);
+        append(Format::EvalBefore, row.evalBefore);
+        append(Format::EvalAfter, row.evalAfter);
+        append(Format::TimeRemaining, row.timeRemaining);
+        append(Format::TimeSpentOnMoveBeforeIt, row.timeSpentOnMoveBeforeIt);
+        append(Format::LegalMovesBefore, toUInt8(row.legalMovesBefore));
+        append(Format::LegalMovesAfter, toUInt8(row.legalMovesAfter));
+        append(Format::TimeSpent, row.timeSpent);
+
+        // Within a game the FEN before a ply is the FEN after the previous one, so skip the lookup.
+        bool continues = previous && std::strcmp(row.fenBefore, previous->fenAfter) == 0;
+        append(Format::FenBefore, continues ? lastFenAfter : internFen(row.fenBefore));
+        lastFenAfter = internFen(row.fenAfter);
+        append(Format::FenAfter, lastFenAfter);
+        append(Format::SearchDepth, row.depthAfter);
+        append(Format::Mate, row.mateAfter);
+
+        const SearchDetails& search = row.searchAfter;
+        append(Format::SelDepth, search.seldepth);
+        append(Format::Nodes, search.nodes);
+        append(Format::Nps, search.nps);
+        append(Format::BestMove, search.bestMove);
+        for (size_t i = 0; i < search.pvLength; i++) append(Format::PvMoves, search.pv[i]);
+        append(Format::PvOffsets, static_cast<uint32_t>(columns[Format::PvMoves].size() / sizeof(Move)));
+        rowCount++;
+    }
+
+    void writeChunk() {
+        if (rowCount == 0) return;
+
+        Format::ChunkHeader header = {};
+        header.magic = Format::ChunkMagic;
+        header.rowCount = rowCount;
+        header.columnCount = Format::ColumnCount;
+        header.fenCount = static_cast<uint32_t>(fenIndex.size());
+
+        uint64_t offset = sizeof(header);
+        for (uint32_t c = 0; c < Format::ColumnCount; c++) {
+            Format::ColumnInfo& info = header.columns[c];
+            info.type = Format::columnType(static_cast<Format::Column>(c));
+            info.column = c;
+            info.offset = offset;
+            info.size = columns[c].size();
+            if (info.type != Format::Bytes) {
+                info.min = minimum[c];
+                info.max = maximum[c];
+            }
+            offset += Format::align(info.size);
+        }
+        header.chunkSize = offset;
+
+        chunk.assign(offset, 0);
+        std::memcpy(chunk.data(), &header, sizeof(header));
+        for (uint32_t c = 0; c < Format::ColumnCount; c++) {
+            std::memcpy(chunk.data() + header.columns[c].offset, columns[c].data(), columns[c].size());
+        }
+        writeAll(chunk.data(), chunk.size());
+        resetChunk();
+    }
+
+protected:
+    void begin(uint64_t existingSize) override {
+        resetChunk();
+        if (existingSize == 0) {
+            Format::FileHeader header = {};
+            std::memcpy(header.magic, Format::FileMagic, sizeof(header.magic));
+            header.version = Format::Version;
+            writeAll(reinterpret_cast<const char*>(&header), sizeof(header));
+        }
+    }
+
+    void writeGame(const GameRows& game) override {
+        const PlyRow* previous = nullptr;
+        for (const PlyRow& row : game.rows) {
+            appendRow(row, previous);
+            previous = &row;
+        }
+        if (rowCount >= chunkRows) writeChunk();
+    }
+
+    void flushPending() override {
+        writeChunk();
+    }
+
+public:
+    explicit ColumnarWriter(size_t chunkRows = 1 << 16)
+        : chunkRows(std::max<size_t>(chunkRows, 1)) {
+    }
+
+    ~ColumnarWriter() override {
+        close();
+    }
+
+    // True if `path` is missing, empty or starts with the header of this format version, so appending
+    // to it never mixes chunks of two layouts.
+    static bool canAppendTo(const std::string& path) {
+        std::ifstream in(path, std::ios::binary);
+        Format::FileHeader header;
+        if (!in.read(reinterpret_cast<char*>(&header), sizeof(header))) return in.gcount() == 0;
+        return std::memcmp(header.magic, Format::FileMagic, sizeof(header.magic)) == 0 && header.version == Format::Version;
+    }
+};
@@ -0,0 +1,142 @@
+﻿// CsvWriter.h : Formats finished games as CSV rows for the asynchronous writer.
+
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <concepts>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "AsyncGameWriter.h"
+
+// Rows are formatted with std::to_chars into one large buffer, appended with a single write once it fills.
+// After the FENs come the search depth, the mate distance (empty if none), seldepth, nodes, nps, the best
+// move and the principal variation as space-separated UCI moves.
+class CsvWriter : public AsyncGameWriter {
+public:
+    // Every field, the last included, is followed by a comma.
+    static constexpr size_t FieldCount = 22;
+
+private:
+    static constexpr size_t MaxRowLength = 1024;
+
+    size_t bufferSize;
+    std::vector<char> buffer;
+    size_t used = 0;
+
+    static char* appendNumber(char* out, double value) {
+        // Precision 6 in general format is exactly what the default iostream formatting printed.
+        return std::to_chars(out, out + 32, value, std::chars_format::general, 6).ptr;
+    }
+
+    // A ply left unsearched has NaN evaluations; they are written as empty fields.
+    static char* appendEvaluation(char* out, double value) {
+        return std::isnan(value) ? out : appendNumber(out, value);
+    }
+
+    template <std::integral Integer>
+    static char* appendNumber(char* out, Integer value) {
+        return std::to_chars(out, out + 24, value).ptr;
+    }
+
+    static char* appendText(char* out, const char* text) {
+        size_t length = std::strlen(text);
+        std::memcpy(out, text, length);
+        return out + length;
+    }
+
+    void appendRow(const PlyRow& row) {
+        if (buffer.size() - used < MaxRowLength) flushPending();
+
+        char* out = buffer.data() + used;
+        out = appendNumber(out, row.ply);
+        *out++ = ',';
+        *out++ = row.kingSideCastle ? '1' : '0';
+        *out++ = ',';
+        *out++ = row.queenSideCastle ? '1' : '0';
+        *out++ = ',';
+        *out++ = row.checkBefore ? '1' : '0';
+        *out++ = ',';
+        *out++ = row.checkAfter ? '1' : '0';
+        *out++ = ',';
+        out = appendEvaluation(out, row.evalAfter - row.evalBefore);
+        *out++ = ',';
+        out = appendEvaluation(out, row.evalBefore);
+        *out++ = ',';
+        out = appendEvaluation(out, row.evalAfter);
+        *out++ = ',';
+        out = appendNumber(out, row.timeRemaining);
+        *out++ = ',';
+        out = appendNumber(out, row.timeSpentOnMoveBeforeIt);
+        *out++ = ',';
+        out = appendNumber(out, row.legalMovesBefore);
+        *out++ = ',';
+        out = appendNumber(out, row.legalMovesAfter);
+        *out++ = ',';
+        out = appendNumber(out, row.timeSpent);
+        *out++ = ',';
+        out = appendText(out, row.fenBefore);
+        *out++ = ',';
+        out = appendText(out, row.fenAfter);
+        *out++ = ',';
+        out = appendNumber(out, uint32_t(row.depthAfter));
+        *out++ = ',';
+        if (row.mateAfter != 0) out = appendNumber(out, int32_t(row.mateAfter));
+        *out++ = ',';
+        const SearchDetails& search = row.searchAfter;
+        out = appendNumber(out, uint32_t(search.seldepth));
+        *out++ = ',';
+        out = appendNumber(out, search.nodes);
+        *out++ = ',';
+        out = appendNumber(out, search.nps);
+        *out++ = ',';
+        if (search.bestMove != InvalidMove) out = writeUci(search.bestMove, out);
+        *out++ = ',';
+        for (size_t i = 0; i < search.pvLength; i++) {
+            if (i > 0) *out++ = ' ';
+            out = writeUci(search.pv[i], out);
+        }
+        *out++ = ',';
+        *out++ = '\n';
+        used = out - buffer.data();
+    }
+
+protected:
+    void begin(uint64_t) override {
+        buffer.assign(std::max(bufferSize, 2 * MaxRowLength), 0);
+        used = 0;
+    }
+
+    void writeGame(const GameRows& game) override {
+        for (const PlyRow& row : game.rows) {
+            appendRow(row);
+        }
+    }
+
+    void flushPending() override {
+        writeAll(buffer.data(), used);
+        used = 0;
+    }
+
+public:
+    explicit CsvWriter(size_t bufferSize = 1 << 20)
+        : bufferSize(bufferSize) {
+    }
+
+    // True if `path` is missing, empty or starts with a row of FieldCount fields, so appending to it
+    // keeps every row the same shape.
+    static bool canAppendTo(const std::string& path) {
+        std::ifstream in(path, std::ios::binary);
+        std::string firstRow;
+        if (!std::getline(in, firstRow)) return true;
+        return static_cast<size_t>(std::count(firstRow.begin(), firstRow.end(), ',')) == FieldCount;
+    }
+
+    ~CsvWriter() override {
+        close();
+    }
+};
@@ -0,0 +1,235 @@
+﻿// EngineEventLoop.h : Drives any number of engine processes from one thread. Searches are queued per
+// engine and started as soon as the engine is free; the engines' output is parsed as it arrives.
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif
+
+#include "StockfishEngine.h"
+
+// On Linux one thread waits on every engine's output pipe with epoll, so the thread count stays the same
+// however many engines run; the pipes are non-blocking while the loop exists and blocking again after.
+// Elsewhere each engine gets a thread that does the same with blocking reads. While the loop exists it
+// owns the engines' I/O: don't call their blocking methods until it is destroyed.
+class EngineEventLoop {
+public:
+    // Called on the loop's thread when a search completes; it may queue further searches.
+    using Callback = std::function<void(SearchResult&&)>;
+
+private:
+    struct Pending {
+        SearchRequest request;
+        Callback done;
+    };
+
+    struct Slot {
+        StockfishEngine* engine = nullptr;
+        std::deque<Pending> queue; // the front is running while `busy`
+        bool busy = false;
+    };
+
+    std::vector<Slot> slots;
+    std::mutex mutex;
+    bool stopping = false;
+    std::vector<std::thread> threads;
+#ifdef __linux__
+    int epollFd = -1;
+    int wakeFd = -1;
+#else
+    std::condition_variable wake;
+#endif
+
+    // Starts the next queued search of slot `index` if the engine is free. Searches queued for an
+    // engine that has stopped complete at once, without an answer.
+    void startNext(size_t index) {
+        Slot& slot = slots[index];
+        while (true) {
+            std::unique_lock<std::mutex> lock(mutex);
+            if (slot.busy || slot.queue.empty()) return;
+            slot.busy = true;
+            // References to deque elements survive push_back, so the request is safe to use unlocked
+            const SearchRequest& request = slot.queue.front().request;
+            lock.unlock();
+
+            if (slot.engine->isRunning()) {
+                slot.engine->beginSearch(request);
+                if (slot.engine->isRunning()) return;
+            }
+            SearchResult result;
+            slot.engine->abandonSearch(result);
+            complete(index, std::move(result));
+        }
+    }
+
+    // Hands the running search of slot `index` its result.
+    void complete(size_t index, SearchResult&& result) {
+        Slot& slot = slots[index];
+        Pending done;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            done = std::move(slot.queue.front());
+            slot.queue.pop_front();
+            slot.busy = false;
+        }
+        done.done(std::move(result));
+    }
+
+    // Passes one line of slot `index`'s output to its running search.
+    void onLine(size_t index, const std::string& line) {
+        SearchResult result;
+        if (slots[index].busy && slots[index].engine->onOutputLine(line, result)) {
+            complete(index, std::move(result));
+            startNext(index);
+        }
+    }
+
+#ifdef __linux__
+    void run() {
+        std::vector<epoll_event> events(64);
+        while (true) {
+            int ready = epoll_wait(epollFd, events.data(), static_cast<int>(events.size()), -1);
+            if (ready < 0 && errno != EINTR) return;
+
+            for (int e = 0; e < ready; e++) {
+                size_t index = events[e].data.u64;
+                if (index == slots.size()) {
+                    uint64_t wakeups;
+                    ssize_t ignored = read(wakeFd, &wakeups, sizeof(wakeups));
+                    (void)ignored;
+                    continue;
+                }
+
+                Slot& slot = slots[index];
+                bool open = slot.engine->readAvailable([&](const std::string& line) { onLine(index, line); });
+                if (!open) {
+                    // The engine has exited: fail what it was running, and everything queued behind it
+                    epoll_ctl(epollFd, EPOLL_CTL_DEL, slot.engine->outputHandle(), nullptr);
+                    if (slot.busy) {
+                        SearchResult result;
+                        slot.engine->abandonSearch(result);
+                        complete(index, std::move(result));
+                    }
+                }
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (stopping) return;
+            }
+            for (size_t i = 0; i < slots.size(); i++) startNext(i);
+        }
+    }
+#else
+    void run(size_t index) {
+        Slot& slot = slots[index];
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&]() { return stopping || !slot.queue.empty(); });
+                if (stopping) return;
+            }
+            startNext(index);
+            while (true) {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if (!slot.busy) break;
+                }
+                std::string line = slot.engine->readLine();
+                if (!slot.engine->isRunning()) {
+                    SearchResult result;
+                    slot.engine->abandonSearch(result);
+                    complete(index, std::move(result));
+                    startNext(index);
+                    continue;
+                }
+                onLine(index, line);
+            }
+        }
+    }
+#endif
+
+public:
+    explicit EngineEventLoop(const std::vector<StockfishEngine*>& engines)
+        : slots(engines.size()) {
+        for (size_t i = 0; i < engines.size(); i++) slots[i].engine = engines[i];
+#ifdef __linux__
+        epollFd = epoll_create1(EPOLL_CLOEXEC);
+        wakeFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.u64 = slots.size();
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &event);
+        for (size_t i = 0; i < slots.size(); i++) {
+            if (!slots[i].engine->isRunning()) continue;
+            slots[i].engine->setNonBlockingOutput(true);
+            event.data.u64 = i;
+            epoll_ctl(epollFd, EPOLL_CTL_ADD, slots[i].engine->outputHandle(), &event);
+        }
+        threads.emplace_back(&EngineEventLoop::run, this);
+#else
+        for (size_t i = 0; i < slots.size(); i++) threads.emplace_back(&EngineEventLoop::run, this, i);
+#endif
+    }
+
+    EngineEventLoop(const EngineEventLoop&) = delete;
+    EngineEventLoop& operator=(const EngineEventLoop&) = delete;
+
+    // Searches still queued are dropped without their callbacks; wait for them first.
+    ~EngineEventLoop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+#ifdef __linux__
+        uint64_t one = 1;
+        ssize_t ignored = write(wakeFd, &one, sizeof(one));
+        (void)ignored;
+#else
+        wake.notify_all();
+#endif
+        for (auto& t : threads) t.join();
+#ifdef __linux__
+        close(epollFd);
+        close(wakeFd);
+        for (Slot& slot : slots) slot.engine->setNonBlockingOutput(false);
+#endif
+    }
+
+    size_t size() const {
+        return slots.size();
+    }
+
+    // Queues `request` on engine `index` and returns at once; `done` gets the result. Safe from any thread.
+    void search(size_t index, SearchRequest request, Callback done) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            slots[index].queue.push_back({ std::move(request), std::move(done) });
+        }
+#ifdef __linux__
+        uint64_t one = 1;
+        ssize_t ignored = write(wakeFd, &one, sizeof(one));
+        (void)ignored;
+#else
+        wake.notify_all();
+#endif
+    }
+
+    // The same, with the result delivered through a future.
+    std::future<SearchResult> search(size_t index, SearchRequest request) {
+        auto promise = std::make_shared<std::promise<SearchResult>>();
+        std::future<SearchResult> result = promise->get_future();
+        search(index, std::move(request), [promise](SearchResult&& searched) { promise->set_value(std::move(searched)); });
+        return result;
+    }
+};
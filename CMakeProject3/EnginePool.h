@@ -0,0 +1,94 @@
+﻿// EnginePool.h : A set of engine processes sharing one thread/hash budget, and the
+// work-stealing queues that feed games to them.
+
+#pragma once
+
+#include <algorithm>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "StockfishEngine.h"
+
+class EnginePool {
+private:
+    std::vector<std::unique_ptr<StockfishEngine>> engines;
+    std::vector<EngineResources> layout;
+
+public:
+    // Starts `count` engines, giving each an equal share of the thread and hash budget.
+    bool init(size_t count, int totalThreads, int totalHashMb, const std::string& path = StockfishEngine::defaultPath) {
+        if (count == 0) count = 1;
+        EngineResources share;
+        share.threads = std::max(1, totalThreads / static_cast<int>(count));
+        share.hashMb = std::max(16, totalHashMb / static_cast<int>(count));
+        return init(std::vector<EngineResources>(count, share), path);
+    }
+
+    // Starts one engine per entry of `plan` (see SystemTopology::partition), replacing any running engines.
+    bool init(const std::vector<EngineResources>& plan, const std::string& path = StockfishEngine::defaultPath) {
+        size_t count = plan.size();
+        layout = plan;
+        engines.clear();
+        for (size_t i = 0; i < count; i++) {
+            engines.push_back(std::make_unique<StockfishEngine>());
+        }
+
+        // Engines allocate their hash during "isready", so bring them up side by side.
+        std::vector<char> started(count, 0);
+        std::vector<std::thread> starters;
+        for (size_t i = 0; i < count; i++) {
+            starters.emplace_back([&, i]() {
+                started[i] = engines[i]->init(path, plan[i]);
+            });
+        }
+        for (auto& t : starters) t.join();
+
+        return count > 0 && std::all_of(started.begin(), started.end(), [](char ok) { return ok != 0; });
+    }
+
+    const std::vector<EngineResources>& resources() const {
+        return layout;
+    }
+
+    size_t size() const {
+        return engines.size();
+    }
+
+    StockfishEngine& engine(size_t index) {
+        return *engines[index];
+    }
+};
+
+// Per-worker deque of game indices. The owner takes work from the front,
+// idle workers steal from the back.
+class WorkStealingQueue {
+private:
+    std::deque<size_t> items;
+    std::mutex mutex;
+
+public:
+    void push(size_t item) {
+        std::lock_guard<std::mutex> lock(mutex);
+        items.push_back(item);
+    }
+
+    bool pop(size_t& item) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (items.empty()) return false;
+        item = items.front();
+        items.pop_front();
+        return true;
+    }
+
+    bool steal(size_t& item) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (items.empty()) return false;
+        item = items.back();
+        items.pop_back();
+        return true;
+    }
+};
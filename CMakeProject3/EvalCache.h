@@ -0,0 +1,169 @@
+﻿// EvalCache.h : Persistent evaluation cache shared between runs and between analyzer processes.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include "MappedFile.h"
+
+// A fixed-size open-addressing table in a memory-mapped file, keyed by the Zobrist hash of the
+// position. Entries are grouped four to a 64-byte bucket; a key may live anywhere in its bucket.
+//
+// There are no locks. Every entry is two 64-bit words, the packed data and key ^ data, each read and
+// written atomically. A reader only accepts an entry whose words xor back to its key, so an entry that
+// another thread or process is overwriting at the same moment reads as a miss instead of as garbage.
+class EvalCache {
+public:
+    struct Entry {
+        int32_t score = 0;      // centipawns, from the side to move
+        int8_t mate = 0;        // moves to mate (negative when being mated), 0 if the search found none
+        uint8_t legalMoves = 0;
+        uint8_t depth = 0;
+    };
+
+private:
+    static constexpr uint64_t Magic = 0x3143564545535343ULL; // "CSSEEVC1"
+    static constexpr uint32_t Version = 2; // 2 stores the mate distance
+    static constexpr size_t EntriesPerBucket = 4;
+
+    struct Header {
+        uint64_t magic;
+        uint32_t version;
+        uint32_t reserved;
+        uint64_t bucketCount;
+        char padding[40];
+    };
+
+    struct Slot {
+        uint64_t keyXorData;
+        uint64_t data;
+    };
+
+    static_assert(sizeof(Header) == 64, "header must keep the table cache-line aligned");
+    static_assert(sizeof(Slot) * EntriesPerBucket == 64, "a bucket must fill one cache line");
+
+    MappedFile file;
+    Slot* slots = nullptr;
+    uint64_t bucketMask = 0;
+
+    // data layout: score (32 bits) | mate (8) | legalMoves (8) | depth (8) | 1 (valid bit, so data is never 0)
+    static uint64_t pack(const Entry& entry) {
+        return static_cast<uint64_t>(static_cast<uint32_t>(entry.score)) |
+            static_cast<uint64_t>(static_cast<uint8_t>(entry.mate)) << 32 |
+            static_cast<uint64_t>(entry.legalMoves) << 40 |
+            static_cast<uint64_t>(entry.depth) << 48 |
+            uint64_t(1) << 56;
+    }
+
+    static Entry unpack(uint64_t data) {
+        Entry entry;
+        entry.score = static_cast<int32_t>(static_cast<uint32_t>(data));
+        entry.mate = static_cast<int8_t>(static_cast<uint8_t>(data >> 32));
+        entry.legalMoves = static_cast<uint8_t>(data >> 40);
+        entry.depth = static_cast<uint8_t>(data >> 48);
+        return entry;
+    }
+
+    static uint64_t loadWord(uint64_t& word) {
+        return std::atomic_ref<uint64_t>(word).load(std::memory_order_relaxed);
+    }
+
+    static void storeWord(uint64_t& word, uint64_t value) {
+        std::atomic_ref<uint64_t>(word).store(value, std::memory_order_relaxed);
+    }
+
+public:
+    // Opens the cache at `path`, creating it with room for about `sizeMb` megabytes of entries.
+    // An existing cache keeps its own size. Returns false if the file can't be mapped or isn't a cache.
+    bool open(const std::string& path, size_t sizeMb) {
+        size_t buckets = 1;
+        while (buckets * 2 * 64 <= sizeMb * 1024 * 1024) buckets *= 2;
+
+        // Reuse the table size of an existing cache, so processes configured differently still agree.
+        MappedFile existing;
+        if (existing.openReadOnly(path) && existing.size() >= sizeof(Header)) {
+            Header header;
+            std::memcpy(&header, existing.data(), sizeof(Header));
+            if (header.magic == Magic) {
+                if (header.version != Version || existing.size() != sizeof(Header) + header.bucketCount * 64) {
+                    return false;
+                }
+                buckets = static_cast<size_t>(header.bucketCount);
+            }
+            else if (header.magic != 0 || existing.size() != sizeof(Header) + buckets * 64) {
+                // Not a cache, or one another process is still creating with a different size
+                return false;
+            }
+        }
+        existing.close();
+
+        if (!file.openShared(path, sizeof(Header) + buckets * 64)) return false;
+
+        // A new file is all zeros. Several processes may get here at once, but they write identical values.
+        Header* header = reinterpret_cast<Header*>(file.data());
+        if (header->magic == 0) {
+            header->version = Version;
+            header->bucketCount = buckets;
+            std::atomic_ref<uint64_t>(header->magic).store(Magic, std::memory_order_release);
+        }
+
+        slots = reinterpret_cast<Slot*>(file.data() + sizeof(Header));
+        bucketMask = buckets - 1;
+        return true;
+    }
+
+    bool isOpen() const {
+        return slots != nullptr;
+    }
+
+    // Looks up `key` and fills `entry` if it was stored with at least `minDepth`.
+    bool probe(uint64_t key, int minDepth, Entry& entry) const {
+        if (!slots) return false;
+        Slot* bucket = slots + (key & bucketMask) * EntriesPerBucket;
+        for (size_t i = 0; i < EntriesPerBucket; i++) {
+            uint64_t data = loadWord(bucket[i].data);
+            uint64_t keyXorData = loadWord(bucket[i].keyXorData);
+            if (data != 0 && (keyXorData ^ data) == key) {
+                entry = unpack(data);
+                return entry.depth >= minDepth;
+            }
+        }
+        return false;
+    }
+
+    // Stores `entry` for `key`. An existing entry for the key is only overwritten by a deeper or equal
+    // search; otherwise an empty slot is used, or failing that the shallowest entry in the bucket.
+    void store(uint64_t key, const Entry& entry) {
+        if (!slots) return;
+        Slot* bucket = slots + (key & bucketMask) * EntriesPerBucket;
+        Slot* victim = nullptr;
+        int victimDepth = 256;
+
+        for (size_t i = 0; i < EntriesPerBucket; i++) {
+            uint64_t data = loadWord(bucket[i].data);
+            uint64_t keyXorData = loadWord(bucket[i].keyXorData);
+            if (data != 0 && (keyXorData ^ data) == key) {
+                if (unpack(data).depth > entry.depth) return;
+                victim = &bucket[i];
+                break;
+            }
+
+            int depth = data == 0 ? -1 : unpack(data).depth;
+            if (depth < victimDepth) {
+                victim = &bucket[i];
+                victimDepth = depth;
+            }
+        }
+
+        uint64_t data = pack(entry);
+        storeWord(victim->data, data);
+        storeWord(victim->keyXorData, key ^ data);
+    }
+
+    void flush() {
+        file.flush();
+    }
+};
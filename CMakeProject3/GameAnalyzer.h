@@ -0,0 +1,930 @@
+﻿// GameAnalyzer.h : Parses the game files and turns every ply into a labeled CSV row.
+
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <algorithm>
+#include <fstream>
+#include <vector>
+#include <sstream>
+#include <cstring>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <memory>
+#include <iomanip>
+#include <optional>
+#include <condition_variable>
+#include <deque>
+#include <limits>
+
+#include "ChessPosition.h"
+#include "StockfishEngine.h"
+#include "EnginePool.h"
+#include "EngineEventLoop.h"
+#include "SystemTopology.h"
+#include "PositionCommand.h"
+#include "MoveTrie.h"
+#include "EvalCache.h"
+#include "CsvWriter.h"
+#include "ColumnarWriter.h"
+#include "ResumeManifest.h"
+#include "Stats.h"
+#include "GameFileParser.h"
+#include "PlyFilter.h"
+
+// Collects finished games and hands them to the output writer strictly in game order,
+// so each game's rows stay together no matter which engine finished first.
+class OrderedGameWriter {
+private:
+    AsyncGameWriter& out;
+    std::vector<GameRows> pending;
+    std::vector<char> ready;
+    size_t nextToWrite = 0;
+    std::mutex mutex;
+
+public:
+    OrderedGameWriter(AsyncGameWriter& out, size_t gameCount)
+        : out(out), pending(gameCount), ready(gameCount, 0) {
+    }
+
+    void complete(size_t gameIndex, GameRows rows) {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending[gameIndex] = std::move(rows);
+        ready[gameIndex] = 1;
+
+        while (nextToWrite < ready.size() && ready[nextToWrite]) {
+            out.submit(std::move(pending[nextToWrite]));
+            nextToWrite++;
+        }
+    }
+};
+
+class GameAnalyzer {
+private:
+    EnginePool engines;
+    std::mutex consoleMutex;
+    bool incrementalPositions = true;
+    EvalCache evalCache;
+    ResumeManifest manifest;
+    std::unique_ptr<AsyncGameWriter> output;
+    bool tuning = false; // autotune runs: no console output per game, no evaluation cache, no stats
+    bool sharedPrefixes = true;
+    bool plyPipelining = false;
+    SearchLimits searchLimits;
+    PlyFilter plyFilter;
+
+    // Records one finished search in the stats.
+    void countSearch(const SearchResult& result) {
+        if (tuning) return;
+        pipelineStats.searches++;
+        pipelineStats.nodes += result.nodes;
+        pipelineStats.engineNps += result.nps;
+        pipelineStats.depths += result.depth;
+        if (result.stoppedEarly) pipelineStats.earlyStops++;
+    }
+
+    // A ply the filter left out: only what our own board knows, with no evaluation (NaN, an empty CSV
+    // field) and depth 0.
+    void unsearchedPly(const ChessPosition& position, char* fenAfter, double& evalAfter, double& legalMovesAfter) {
+        position.writeFen(fenAfter);
+        evalAfter = std::numeric_limits<double>::quiet_NaN();
+        legalMovesAfter = position.countLegalMoves();
+        if (!tuning) pipelineStats.skippedPlies++;
+    }
+
+    // The search's mate distance as rows and the cache keep it, in eight bits.
+    static int8_t mateIn(const SearchResult& result) {
+        return static_cast<int8_t>(std::clamp(result.mate, -127, 127));
+    }
+
+    // Copies what a search found besides the score and legal moves into the row of the ply it answers.
+    static void recordSearch(const SearchResult& result, PlyRow& row) {
+        row.depthAfter = static_cast<uint8_t>(result.depth);
+        row.mateAfter = mateIn(result);
+        row.searchAfter = searchDetails(result);
+    }
+
+    static SearchDetails searchDetails(const SearchResult& result) {
+        SearchDetails details;
+        details.seldepth = static_cast<uint8_t>(std::clamp(result.seldepth, 0, 255));
+        details.bestMove = result.bestMove;
+        details.nodes = result.nodes;
+        details.nps = result.nps;
+        std::span<const Move> pv = result.principalVariation();
+        details.pvLength = static_cast<uint8_t>(std::min(pv.size(), SearchDetails::MaxPvLength));
+        std::copy_n(pv.begin(), details.pvLength, details.pv);
+        return details;
+    }
+
+    static EvalCache::Entry cacheEntry(const SearchResult& result) {
+        EvalCache::Entry entry;
+        entry.score = static_cast<int32_t>(result.score);
+        entry.mate = mateIn(result);
+        entry.legalMoves = static_cast<uint8_t>(result.legalMoves);
+        entry.depth = static_cast<uint8_t>(std::clamp(result.depth, 0, 255));
+        return entry;
+    }
+
+    // The key the position after a ply is cached under, or 0 where the cache is not used: it is closed,
+    // autotune is running, or our board has lost track of the game. `history` holds the hashes of the
+    // game's positions up to this one. The engine is sent the moves since the last irreversible one, so
+    // its answer depends on more than the position: the halfmove clock is folded into the key, and a
+    // position that already occurred since then (a repetition, at the earliest four plies on) is not cached.
+    uint64_t cacheKey(const ChessPosition& position, bool boardInSync, std::span<const uint64_t> history) const {
+        if (!boardInSync || !evalCache.isOpen() || tuning) return 0;
+        size_t clock = static_cast<size_t>(position.getHalfmoveClock());
+        for (size_t back = 4; back <= clock && back < history.size(); back += 2) {
+            if (history[history.size() - 1 - back] == position.hash()) return 0;
+        }
+        return position.hash() ^ clock * 0x9E3779B97F4A7C15ULL;
+    }
+
+    // Looks up the evaluation cached under `key`, if it was searched deep enough. A key of 0 never hits.
+    bool probeCache(uint64_t key, EvalCache::Entry& cached) {
+        if (key == 0) return false;
+        bool hit;
+        {
+            PipelineStats::Timer timer(pipelineStats, Stage::CacheProbe);
+            hit = evalCache.probe(key, StockfishEngine::searchDepth, cached);
+        }
+        if (hit) pipelineStats.cacheHits++;
+        return hit;
+    }
+
+    // Caches a search under `key`, unless the key is 0 or the engine stopped before answering.
+    void storeCache(uint64_t key, const SearchResult& result) {
+        if (key != 0 && result.completed) evalCache.store(key, cacheEntry(result));
+    }
+
+    // Runs `games[indices[k]]` for every k on the engine pool and hands each finished game to
+    // onGame(k, rows), from whichever worker thread analyzed it. Per-game analysis keeps a thread per
+    // engine, blocking on its reads; only analyzeSharedPrefixes runs on the EngineEventLoop.
+    template <typename OnGame>
+    void runWorkers(const std::vector<GameData>& games, const std::vector<size_t>& indices, OnGame&& onGame) {
+        size_t workerCount = std::min(engines.size(), indices.size());
+        if (workerCount == 0) return;
+
+        // Deal games round-robin so the workers progress through the file roughly in order
+        // and the ordered writer never has to hold back much finished output.
+        std::vector<WorkStealingQueue> queues(workerCount);
+        for (size_t i = 0; i < indices.size(); i++) {
+            queues[i % workerCount].push(i);
+        }
+
+        auto worker = [&](size_t self) {
+            StockfishEngine& engine = engines.engine(self);
+            size_t gameIndex;
+            while (true) {
+                bool found = queues[self].pop(gameIndex);
+                for (size_t k = 1; !found && k < workerCount; k++) {
+                    found = queues[(self + k) % workerCount].steal(gameIndex);
+                }
+                if (!found) break;
+
+                GameRows rows;
+                analyzeGame(games[indices[gameIndex]], engine, rows);
+                onGame(gameIndex, std::move(rows));
+            }
+        };
+
+        std::vector<std::thread> workers;
+        for (size_t i = 1; i < workerCount; i++) {
+            workers.emplace_back(worker, i);
+        }
+        worker(0);
+        for (auto& t : workers) t.join();
+    }
+
+    // Engine results for one trie node; the FEN only when our board had lost track of the game there.
+    struct TrieResult {
+        double eval = 0;
+        double legalMoves = 0;
+        uint8_t depth = 0;
+        int8_t mate = 0;
+        SearchDetails details;
+        std::string engineFen;
+    };
+
+    // Our board and position command after the moves leading to a trie node.
+    struct TrieState {
+        ChessPosition position;
+        PositionCommand command;
+        bool boardInSync = true;
+        const std::string* lastCommand = nullptr;
+    };
+
+    // Plays the move into `node` on a copy of the parent's state, reusing the copy's buffers.
+    static void advance(const MoveTrie& trie, uint32_t node, const TrieState& from, TrieState& to) {
+        to = from;
+        Move move = trie.move(node);
+        bool autoQueen = to.position.isUnmarkedPromotion(move);
+        to.boardInSync = to.position.makeMove(move) && to.boardInSync;
+        to.lastCommand = &to.command.afterMove(move, autoQueen, to.position, to.boardInSync);
+    }
+
+    // Analyzes games[indices[k]] for every k with each position reached by a shared sequence of moves searched
+    // only once. As soon as every position of a game has its result, its rows are built and handed to
+    // onGame(k, rows), in whatever order the games finish.
+    template <typename OnGame>
+    void analyzeSharedPrefixes(const std::vector<GameData>& games, const std::vector<size_t>& indices, OnGame&& onGame) {
+        MoveTrie trie;
+        trie.build(games, indices);
+
+        // The games through each node, and how many of each game's positions still await their result
+        std::vector<uint32_t> nodeGameStarts(trie.size() + 1, 0);
+        std::vector<uint32_t> nodeGames(trie.plyCount());
+        std::vector<uint32_t> unresolved(indices.size());
+        for (size_t k = 0; k < indices.size(); k++) {
+            for (uint32_t node : trie.path(k)) nodeGameStarts[node + 1]++;
+            unresolved[k] = static_cast<uint32_t>(trie.path(k).size());
+        }
+        for (size_t n = 0; n < trie.size(); n++) nodeGameStarts[n + 1] += nodeGameStarts[n];
+        {
+            std::vector<uint32_t> filled(nodeGameStarts.begin(), nodeGameStarts.end() - 1);
+            for (size_t k = 0; k < indices.size(); k++) {
+                for (uint32_t node : trie.path(k)) nodeGames[filled[node]++] = static_cast<uint32_t>(k);
+            }
+        }
+
+        // Which plies each game wants searched (see PlyFilter), game after game, and the positions they reach
+        std::vector<char> selected;
+        std::vector<char> gameSelection;
+        std::vector<size_t> selectionStarts(1, 0);
+        std::vector<char> wanted(trie.size(), plyFilter.enabled() ? 0 : 1);
+        for (size_t k = 0; k < indices.size(); k++) {
+            plyFilter.select(games[indices[k]], gameSelection);
+            std::span<const uint32_t> path = trie.path(k);
+            for (size_t i = 0; i < path.size(); i++) {
+                if (gameSelection[i]) wanted[path[i]] = 1;
+            }
+            selected.insert(selected.end(), gameSelection.begin(), gameSelection.end());
+            selectionStarts.push_back(selected.size());
+        }
+
+        // Each game used to cost one search per ply plus one of the starting position
+        size_t distinct = trie.size() - 1;
+        size_t saved = trie.plyCount() + indices.size() - distinct;
+        if (!tuning) {
+            pipelineStats.sharedPlies += trie.plyCount() - distinct;
+            std::lock_guard<std::mutex> lock(consoleMutex);
+            std::cout << "Shared prefixes: " << trie.plyCount() << " plies of " << indices.size() << " games reach "
+                << distinct << " distinct positions, " << saved << " engine searches saved" << std::endl;
+        }
+
+        size_t longestGame = 0;
+        for (size_t index : indices) longestGame = std::max(longestGame, games[index].moves.size());
+
+        // One thread drives every engine through the event loop. Each engine takes the games in file order,
+        // one at a time, and searches the positions of its game that no engine has taken yet: games complete
+        // about in the order the output takes them, each search follows the one before it in the same game
+        // and finds the engine's hash warm, and a second search is kept queued so the engine never waits
+        // for our bookkeeping in between.
+        const size_t searchesAhead = 2;
+        struct Walker {
+            std::vector<TrieState> stack;  // stack[d]: the state after the d-th ply of the games walked so far
+            std::vector<uint32_t> nodes;   // the node stack[d] is the state of; a node always has the same state
+            std::vector<uint64_t> hashes;  // of the positions in `stack`, for cacheKey
+            size_t game = SIZE_MAX;        // the game being walked, and the next of its plies
+            size_t ply = 0;
+            size_t inFlight = 0;
+        };
+        struct Completion {
+            size_t engine;
+            uint32_t node;
+            uint64_t positionKey; // 0 when the result is not to be cached
+            bool engineFen;       // our board had lost track of the game
+            std::chrono::steady_clock::time_point submitted;
+            SearchResult result;
+        };
+
+        std::vector<Walker> walkers(engines.size());
+        std::vector<StockfishEngine*> enginePointers;
+        for (size_t e = 0; e < engines.size(); e++) {
+            walkers[e].stack.assign(longestGame + 1, TrieState{ ChessPosition(), PositionCommand(incrementalPositions) });
+            walkers[e].nodes.assign(longestGame + 1, MoveTrie::None);
+            walkers[e].nodes[0] = 0;
+            walkers[e].hashes.assign(longestGame + 1, ChessPosition().hash());
+            enginePointers.push_back(&engines.engine(e));
+        }
+
+        std::mutex completionMutex;
+        std::condition_variable completionReady;
+        std::deque<Completion> completions;
+        EngineEventLoop loop(enginePointers);
+        size_t nextGame = 0;
+        size_t inFlight = 0;
+        std::vector<char> taken(trie.size(), 0);
+        std::vector<TrieResult> results(trie.size());
+
+        // Builds game k's rows from the results of its positions and hands them on.
+        auto finishGame = [&](size_t k) {
+            const GameData& game = games[indices[k]];
+            std::span<const uint32_t> path = trie.path(k);
+            if (!tuning) printGameHeader(game);
+
+            GameRows rows;
+            buildRows(game, rows, false, [&](size_t i, bool, const ChessPosition& position, bool boardInSync,
+                char* fenAfter, double& evalAfter, double& legalMovesAfter) {
+                if (!selected[selectionStarts[k] + i] && boardInSync) {
+                    unsearchedPly(position, fenAfter, evalAfter, legalMovesAfter);
+                    return;
+                }
+                const TrieResult& result = results[path[i]];
+                if (boardInSync) position.writeFen(fenAfter);
+                else std::strcpy(fenAfter, result.engineFen.c_str());
+                evalAfter = result.eval;
+                legalMovesAfter = result.legalMoves;
+                rows.rows[i].depthAfter = result.depth;
+                rows.rows[i].mateAfter = result.mate;
+                rows.rows[i].searchAfter = result.details;
+            });
+            onGame(k, std::move(rows));
+
+            if (!tuning) printGameFooter();
+        };
+        for (size_t k = 0; k < indices.size(); k++) {
+            if (unresolved[k] == 0) finishGame(k);
+        }
+
+        // Nodes whose result is in (searched, from the cache, or only passed through), not yet counted off
+        // their games. They are counted once the engine has its next search, so building rows never keeps it waiting.
+        std::vector<uint32_t> resolved;
+        auto drainResolved = [&]() {
+            for (uint32_t node : resolved) {
+                for (uint32_t g = nodeGameStarts[node]; g < nodeGameStarts[node + 1]; g++) {
+                    if (--unresolved[nodeGames[g]] == 0) finishGame(nodeGames[g]);
+                }
+            }
+            resolved.clear();
+        };
+
+        // Queues engine `e`'s next search, answering positions from the cache on the way. False once the
+        // engine has nothing left to search.
+        auto searchNext = [&](size_t e) {
+            Walker& walker = walkers[e];
+            while (true) {
+                if (walker.game == SIZE_MAX || walker.ply == trie.path(walker.game).size()) {
+                    if (nextGame == indices.size()) return false;
+                    walker.game = nextGame++;
+                    walker.ply = 0;
+                }
+
+                // The states the game shares with the ones walked before are already on the stack
+                uint32_t node = trie.path(walker.game)[walker.ply];
+                size_t depth = ++walker.ply;
+                TrieState& state = walker.stack[depth];
+                if (walker.nodes[depth] != node) {
+                    advance(trie, node, walker.stack[depth - 1], state);
+                    walker.nodes[depth] = node;
+                    walker.hashes[depth] = state.position.hash();
+                }
+                if (taken[node]) continue;
+                taken[node] = 1;
+
+                // Positions no game wants searched are only passed through, unless our board has lost track there
+                if (!wanted[node] && state.boardInSync) {
+                    resolved.push_back(node);
+                    continue;
+                }
+
+                // The legal moves are counted on our own board unless it rejected a move and can no longer be trusted.
+                TrieResult& result = results[node];
+                uint64_t positionKey = cacheKey(state.position, state.boardInSync, std::span(walker.hashes).first(depth + 1));
+                EvalCache::Entry cached;
+                if (probeCache(positionKey, cached)) {
+                    result.eval = cached.score;
+                    result.legalMoves = cached.legalMoves;
+                    result.depth = cached.depth;
+                    result.mate = cached.mate;
+                    resolved.push_back(node);
+                    continue;
+                }
+
+                SearchRequest request;
+                request.command = *state.lastCommand;
+                request.engineFen = !state.boardInSync;
+                if (state.boardInSync) {
+                    PipelineStats::Timer timer(pipelineStats, Stage::Perft, !tuning);
+                    request.legalMoves = state.position.countLegalMoves();
+                }
+
+                bool engineFen = request.engineFen;
+                auto submitted = std::chrono::steady_clock::now();
+                loop.search(e, std::move(request), [&, e, node, positionKey, engineFen, submitted](SearchResult&& searched) {
+                    std::lock_guard<std::mutex> lock(completionMutex);
+                    completions.push_back({ e, node, positionKey, engineFen, submitted, std::move(searched) });
+                    completionReady.notify_one();
+                });
+                walker.inFlight++;
+                inFlight++;
+                return true;
+            }
+        };
+
+        for (size_t e = 0; e < engines.size(); e++) {
+            for (size_t k = 0; k < searchesAhead && searchNext(e); k++) {}
+        }
+        drainResolved();
+        while (inFlight > 0) {
+            Completion done;
+            {
+                std::unique_lock<std::mutex> lock(completionMutex);
+                completionReady.wait(lock, [&]() { return !completions.empty(); });
+                done = std::move(completions.front());
+                completions.pop_front();
+            }
+            walkers[done.engine].inFlight--;
+            inFlight--;
+
+            const SearchResult& searched = done.result;
+            TrieResult& result = results[done.node];
+            result.eval = searched.score;
+            result.legalMoves = searched.legalMoves;
+            result.depth = static_cast<uint8_t>(searched.depth);
+            result.mate = mateIn(searched);
+            result.details = searchDetails(searched);
+            if (done.engineFen) result.engineFen = searched.fen.substr(0, ChessPosition::FenBufferSize - 1);
+            countSearch(searched);
+            if (!tuning) {
+                pipelineStats.stage(Stage::Search).record(searched.nanoseconds);
+                pipelineStats.stage(Stage::Ply).record(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - done.submitted).count());
+            }
+
+            storeCache(done.positionKey, searched);
+            resolved.push_back(done.node);
+
+            searchNext(done.engine);
+            drainResolved();
+        }
+    }
+
+    void printLayout() {
+        const std::vector<EngineResources>& layout = engines.resources();
+        for (size_t i = 0; i < layout.size(); i++) {
+            std::cout << "Engine " << i << ": " << layout[i].threads << " threads, " << layout[i].hashMb << " MB hash";
+            if (layout[i].numaNode >= 0) std::cout << ", NUMA node " << layout[i].numaNode;
+            std::cout << ", CPUs " << SystemTopology::formatCpuList(layout[i].cpus) << std::endl;
+        }
+    }
+
+public:
+    // Starts `engineCount` engines on this machine's CPUs, NUMA nodes and memory (see SystemTopology::partition).
+    // `totalThreads` and `totalHashMb` of 0 use every available CPU and half of the available memory.
+    bool init(size_t engineCount = 1, int totalThreads = 0, int totalHashMb = 0,
+        const std::string& enginePath = StockfishEngine::defaultPath, bool pin = true) {
+        SystemTopology topology = SystemTopology::detect();
+        if (!engines.init(topology.partition(engineCount, totalThreads, totalHashMb, pin), enginePath)) return false;
+        for (size_t i = 0; i < engines.size(); i++) engines.engine(i).setSearchLimits(searchLimits);
+        printLayout();
+        return true;
+    }
+
+    // Times a few engine layouts (1, 2, 4... engines, and one per NUMA node) on the first plies of a sample of
+    // `games`, then starts the pool with the layout that analyzed the most plies per second. The sample goes
+    // through the same path analyzeGames will take (shared prefixes or one game per worker), without the
+    // evaluation cache or the stats, and its rows are discarded.
+    bool autotune(const std::vector<GameData>& games, int totalThreads = 0, int totalHashMb = 0,
+        const std::string& enginePath = StockfishEngine::defaultPath, bool pin = true) {
+        const size_t samplePlies = 30;
+        SystemTopology topology = SystemTopology::detect();
+        size_t cpus = totalThreads > 0 ? static_cast<size_t>(totalThreads) : topology.cpuCount();
+
+        std::vector<size_t> candidates;
+        for (size_t count = 1; count <= cpus; count *= 2) candidates.push_back(count);
+        size_t nodeCount = topology.nodes().size();
+        if (nodeCount <= cpus && std::find(candidates.begin(), candidates.end(), nodeCount) == candidates.end()) {
+            candidates.push_back(nodeCount);
+        }
+        std::sort(candidates.begin(), candidates.end());
+
+        // Enough games to keep the largest layout busy, cut short so every layout sees the same work
+        std::vector<GameData> sample(games.begin(), games.begin() + std::min(games.size(), 2 * candidates.back()));
+        std::vector<size_t> indices;
+        size_t plies = 0;
+        for (GameData& game : sample) {
+            if (game.moves.size() > samplePlies) game.moves = game.moves.first(samplePlies);
+            plies += game.moves.size();
+            indices.push_back(indices.size());
+        }
+        if (plies == 0) return init(1, totalThreads, totalHashMb, enginePath, pin);
+
+        std::cout << "Autotuning the engine layout on " << sample.size() << " games (" << plies << " plies)" << std::endl;
+        size_t best = 0;
+        double bestRate = -1;
+        tuning = true;
+        for (size_t count : candidates) {
+            if (!engines.init(topology.partition(count, totalThreads, totalHashMb, pin), enginePath)) {
+                tuning = false;
+                return false;
+            }
+            for (size_t i = 0; i < engines.size(); i++) engines.engine(i).setSearchLimits(searchLimits);
+            auto discard = [](size_t, GameRows&&) {};
+            auto start = std::chrono::steady_clock::now();
+            if (sharedPrefixes) analyzeSharedPrefixes(sample, indices, discard);
+            else runWorkers(sample, indices, discard);
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            double rate = plies / std::max(seconds, 1e-9);
+            std::cout << "  " << count << " engines x " << engines.resources()[0].threads << " threads: "
+                << std::fixed << std::setprecision(1) << rate << " plies/s" << std::defaultfloat << std::endl;
+            if (rate > bestRate) {
+                bestRate = rate;
+                best = count;
+            }
+        }
+        tuning = false;
+
+        std::cout << "Using " << best << " engines" << std::endl;
+        return init(best, totalThreads, totalHashMb, enginePath, pin);
+    }
+
+    // Evaluations are looked up in and added to the persistent cache at `path` (created with `sizeMb` MB if new).
+    bool openCache(const std::string& path, size_t sizeMb) {
+        return evalCache.open(path, sizeMb);
+    }
+
+    enum class OutputFormat {
+        Csv,
+        Columnar
+    };
+
+    // Rows are appended to the file at `path` as CSV text or as columnar binary chunks (see ColumnarFormat.h);
+    // `syncEveryGames` > 0 also fsyncs after that many games. Games already recorded in the output's
+    // resume manifest are skipped, and rows left behind by an interrupted run are cut off first. An output
+    // written with other columns (another CSV field count or columnar version) is refused rather than appended to.
+    bool openOutput(const std::string& path, OutputFormat format = OutputFormat::Csv, size_t syncEveryGames = 0) {
+        if (!manifest.open(path)) return false;
+        bool compatible = format == OutputFormat::Columnar ? ColumnarWriter::canAppendTo(path) : CsvWriter::canAppendTo(path);
+        if (!compatible) {
+            std::cerr << "Error: " << path << " holds rows with other columns than this version writes" << std::endl;
+            return false;
+        }
+        if (format == OutputFormat::Columnar) output = std::make_unique<ColumnarWriter>();
+        else output = std::make_unique<CsvWriter>();
+        return output->open(path, syncEveryGames, &manifest);
+    }
+
+    // Incremental (default): send the FEN after the last irreversible move plus the moves since.
+    // Otherwise every ply replays the whole game from "position startpos moves ...".
+    void setIncrementalPositions(bool enabled) {
+        incrementalPositions = enabled;
+    }
+
+    // On (default): every position reached by the same moves in several games of a file is searched once
+    // (see analyzeSharedPrefixes). Otherwise each game is analyzed on its own, as it is played.
+    void setSharedPrefixes(bool enabled) {
+        sharedPrefixes = enabled;
+    }
+
+    // In per-game analysis, lets the engine search ply i while we prepare ply i + 1 (see analyzeGamePipelined).
+    // Off by default: every ply waits for the previous one's search, which measured faster.
+    void setPlyPipelining(bool enabled) {
+        plyPipelining = enabled;
+    }
+
+    // Adaptive searches stop once the evaluation settles or a budget runs out (see SearchLimits), and every
+    // row records the depth its search reached (otherwise the fixed search depth). Set before init().
+    void setSearchLimits(const SearchLimits& limits) {
+        searchLimits = limits;
+    }
+
+    // Only the plies `filter` picks are searched; the rest get an evaluation of NaN and a depth of 0.
+    void setPlyFilter(const PlyFilter& filter) {
+        plyFilter = filter;
+    }
+
+    // Analyzes the games of `inputFile` on the engine pool and appends their rows to the output in input order.
+    bool analyzeGames(const std::vector<GameData>& games, const std::string& inputFile = "") {
+        if (!output && !openOutput("analyzed_game_information.csv")) {
+            std::cerr << "Error: Could not open file " << "analyzed_game_information.csv" << std::endl;
+            return false;
+        }
+
+        // Games that are already in the output (or appeared earlier in this run) are not analyzed again.
+        std::vector<size_t> pendingGames;
+        pendingGames.reserve(games.size());
+        for (size_t i = 0; i < games.size(); i++) {
+            if (manifest.claim(std::string(games[i].gameId))) pendingGames.push_back(i);
+        }
+        if (pendingGames.size() < games.size()) {
+            std::cout << "Skipping " << (games.size() - pendingGames.size()) << " games already analyzed" << std::endl;
+        }
+
+        if (pendingGames.empty()) return true;
+
+        if (!manifest.beginFile(inputFile, output->size())) {
+            std::cerr << "Error: Could not write the resume marker for " << inputFile << std::endl;
+            return false;
+        }
+
+        OrderedGameWriter writer(*output, pendingGames.size());
+        auto onGame = [&writer](size_t gameIndex, GameRows&& rows) {
+            writer.complete(gameIndex, std::move(rows));
+        };
+        if (sharedPrefixes) {
+            analyzeSharedPrefixes(games, pendingGames, onGame);
+        }
+        else {
+            runWorkers(games, pendingGames, onGame);
+        }
+        evalCache.flush();
+
+        // Every file ends with its rows on disk and recorded in the manifest.
+        output->checkpoint();
+        if (!output->ok()) return false;
+        manifest.endFile();
+        return true;
+    }
+
+    GameArena parseGameFile(const std::string& filename) {
+        GameArena games;
+        GameFileParser().parse(filename, games);
+        return games;
+    }
+
+    // Fills `rows` with one row per ply of `game`, using `engine` for the evaluations.
+    void analyzeGame(const GameData& game, StockfishEngine& engine, GameRows& rows) {
+        if (plyPipelining) {
+            analyzeGamePipelined(game, engine, rows);
+            return;
+        }
+        if (!tuning) printGameHeader(game);
+
+        // Start from initial position
+        PositionCommand positionCommand(incrementalPositions);
+
+        // Get initial position evaluation
+        engine.sendCommand("position startpos moves");
+        engine.evaluate(true, ChessPosition().countLegalMoves());
+
+        std::vector<char> selected;
+        plyFilter.select(game, selected);
+        std::vector<uint64_t> history(1, ChessPosition().hash());
+
+        buildRows(game, rows, true, [&](size_t i, bool autoQueen, const ChessPosition& position, bool boardInSync,
+            char* fenAfter, double& evalAfter, double& legalMovesAfter) {
+            history.push_back(position.hash());
+            // Apply the move to Stockfish
+            const std::string& command = positionCommand.afterMove(game.moves[i], autoQueen, position, boardInSync);
+            if (!selected[i] && boardInSync) {
+                unsearchedPly(position, fenAfter, evalAfter, legalMovesAfter);
+                return;
+            }
+            evaluatePly(engine, command, position, boardInSync, history, i % 2 == 0, fenAfter, evalAfter, legalMovesAfter,
+                rows.rows[i]);
+        });
+
+        if (!tuning) printGameFooter();
+    }
+
+private:
+    // analyzeGame with the engine's search of ply i overlapping our own work on ply i + 1: the move, FEN,
+    // legal moves and position command are prepared while the engine searches, and its answer is only
+    // collected right before the next search starts. The rows come out exactly as analyzeGame's.
+    void analyzeGamePipelined(const GameData& game, StockfishEngine& engine, GameRows& rows) {
+        if (!tuning) printGameHeader(game);
+        PositionCommand positionCommand(incrementalPositions);
+
+        // The search still running, and the row its answer belongs to
+        const size_t startingPosition = SIZE_MAX;
+        struct Running {
+            bool active = false;
+            size_t ply = 0;
+            uint64_t positionKey = 0; // 0 when the result is not to be cached
+            bool engineFen = false;
+        } running;
+
+        auto finishRunning = [&]() {
+            if (!running.active) return;
+            running.active = false;
+            SearchResult result;
+            {
+                PipelineStats::Timer timer(pipelineStats, Stage::Search, !tuning);
+                engine.finishSearch(result);
+            }
+            if (running.ply == startingPosition) return;
+
+            countSearch(result);
+            PlyRow& row = rows.rows[running.ply];
+            row.evalAfter = result.score;
+            row.legalMovesAfter = result.legalMoves;
+            recordSearch(result, row);
+            if (running.engineFen) {
+                size_t length = std::min(result.fen.size(), ChessPosition::FenBufferSize - 1);
+                std::memcpy(row.fenAfter, result.fen.data(), length);
+                row.fenAfter[length] = '\0';
+            }
+            storeCache(running.positionKey, result);
+        };
+
+        // The initial position is searched first, as in analyzeGame; only its effect on the engine's hash is kept
+        SearchRequest request;
+        request.command = "position startpos moves";
+        request.legalMoves = ChessPosition().countLegalMoves();
+        engine.beginSearch(request);
+        running = { true, startingPosition };
+
+        std::vector<char> selected;
+        plyFilter.select(game, selected);
+        std::vector<uint64_t> history(1, ChessPosition().hash());
+
+        buildRows(game, rows, true, [&](size_t i, bool autoQueen, const ChessPosition& position, bool boardInSync,
+            char* fenAfter, double& evalAfter, double& legalMovesAfter) {
+            history.push_back(position.hash());
+            request.command = positionCommand.afterMove(game.moves[i], autoQueen, position, boardInSync);
+            // A skipped ply leaves the running search alone; its answer is collected before the next search
+            if (!selected[i] && boardInSync) {
+                unsearchedPly(position, fenAfter, evalAfter, legalMovesAfter);
+                return;
+            }
+            request.engineFen = !boardInSync;
+            request.legalMoves = -1;
+            if (boardInSync) {
+                {
+                    PipelineStats::Timer timer(pipelineStats, Stage::Fen, !tuning);
+                    position.writeFen(fenAfter);
+                }
+                PipelineStats::Timer timer(pipelineStats, Stage::Perft, !tuning);
+                request.legalMoves = position.countLegalMoves();
+            }
+
+            // The previous ply's answer is stored before this ply probes the cache, as analyzeGame does
+            finishRunning();
+
+            uint64_t positionKey = cacheKey(position, boardInSync, history);
+            EvalCache::Entry cached;
+            if (probeCache(positionKey, cached)) {
+                evalAfter = cached.score;
+                legalMovesAfter = cached.legalMoves;
+                rows.rows[i].depthAfter = cached.depth;
+                rows.rows[i].mateAfter = cached.mate;
+                return;
+            }
+
+            // Placeholders until finishRunning fills in the answer
+            evalAfter = 0;
+            legalMovesAfter = 0;
+            {
+                PipelineStats::Timer timer(pipelineStats, Stage::PositionCommand, !tuning);
+                engine.beginSearch(request);
+            }
+            running = { true, i, positionKey, request.engineFen };
+        });
+        finishRunning();
+
+        // Each row starts where the previous one ended; carry over the answers that came in late
+        for (size_t i = 1; i < rows.rows.size(); i++) {
+            rows.rows[i].evalBefore = rows.rows[i - 1].evalAfter;
+            rows.rows[i].legalMovesBefore = rows.rows[i - 1].legalMovesAfter;
+            std::strcpy(rows.rows[i].fenBefore, rows.rows[i - 1].fenAfter);
+        }
+
+        if (!tuning) printGameFooter();
+    }
+
+    void printGameHeader(const GameData& game) {
+        std::lock_guard<std::mutex> lock(consoleMutex);
+        std::cout << "\n=== Analyzing Game: " << game.gameId << " ===" << std::endl;
+        std::cout << "Total moves: " << game.moves.size() << std::endl;
+        std::cout << std::string(80, '=') << std::endl;
+    }
+
+    void printGameFooter() {
+        std::lock_guard<std::mutex> lock(consoleMutex);
+        std::cout << std::string(80, '=') << std::endl;
+    }
+
+    // The engine side of one ply: sends `command` for the position after the move, writes its FEN into
+    // `fenAfter` (from our board while it is in sync, from the engine otherwise) and gets its evaluation
+    // and legal move count, from the cache if the position was searched deep enough before. `history` is
+    // as for cacheKey. `row` gets the search depth and the rest of what the search found (see recordSearch).
+    void evaluatePly(StockfishEngine& engine, const std::string& command, const ChessPosition& position, bool boardInSync,
+        std::span<const uint64_t> history, bool isWhiteMove, char* fenAfter, double& evalAfter, double& legalMovesAfter, PlyRow& row) {
+        {
+            PipelineStats::Timer timer(pipelineStats, Stage::PositionCommand, !tuning);
+            engine.sendCommand(command);
+        }
+
+        // Write the FEN from our own board; the engine's "d" output is only needed once it is out of sync
+        {
+            PipelineStats::Timer timer(pipelineStats, Stage::Fen, !tuning);
+            if (boardInSync) {
+                position.writeFen(fenAfter);
+            }
+            else {
+                std::string engineFen = engine.getFenPosition();
+                size_t length = std::min(engineFen.size(), ChessPosition::FenBufferSize - 1);
+                std::memcpy(fenAfter, engineFen.data(), length);
+                fenAfter[length] = '\0';
+            }
+        }
+
+        // The legal moves are counted on our own board unless it rejected a move and can no longer be trusted.
+        uint64_t positionKey = cacheKey(position, boardInSync, history);
+        EvalCache::Entry cached;
+        if (probeCache(positionKey, cached)) {
+            evalAfter = cached.score;
+            legalMovesAfter = cached.legalMoves;
+            row.depthAfter = cached.depth;
+            row.mateAfter = cached.mate;
+            return;
+        }
+
+        int legalMoves;
+        {
+            PipelineStats::Timer timer(pipelineStats, Stage::Perft, !tuning);
+            legalMoves = boardInSync ? position.countLegalMoves() : engine.countLegalMoves();
+        }
+
+        SearchResult result;
+        {
+            PipelineStats::Timer timer(pipelineStats, Stage::Search, !tuning);
+            result = engine.evaluate(isWhiteMove, legalMoves);
+        }
+        countSearch(result);
+        evalAfter = result.score;
+        legalMovesAfter = result.legalMoves;
+        recordSearch(result, row);
+        storeCache(positionKey, result);
+    }
+
+    // Fills `rows` with one row per ply of `game`. Our own board follows the game; for the position after
+    // every move, evaluatePly(ply, autoQueen, position, boardInSync, fenAfter, evalAfter, legalMovesAfter)
+    // supplies the FEN, evaluation and legal move count. `timePlies` records each ply in Stage::Ply.
+    template <typename EvaluatePly>
+    void buildRows(const GameData& game, GameRows& rows, bool timePlies, EvaluatePly&& evaluatePly) {
+        rows.gameId = game.gameId;
+        rows.rows.clear();
+        rows.rows.reserve(game.moves.size());
+
+        // Initialize chess position
+        ChessPosition position;
+
+        double evalBefore = 0;
+        bool isCheckBefore = position.isInCheck(true); // White starts
+        double legalMovesBefore = 20;
+        double legalMovesAfter = 20;
+        const char* fenBefore = "startup";
+        bool boardInSync = true;
+
+
+        for (size_t i = 0; i < game.moves.size(); ++i) {
+
+
+            std::optional<PipelineStats::Timer> plyTimer;
+            if (timePlies && !tuning) plyTimer.emplace(pipelineStats, Stage::Ply);
+
+            // Determine whose move it is
+            bool isWhiteMove = (i % 2 == 0);
+
+            
+
+            // Apply the move to our position tracker
+            bool autoQueen = position.isUnmarkedPromotion(game.moves[i]);
+            bool moveValid = position.makeMove(game.moves[i]);
+            boardInSync = boardInSync && moveValid;
+
+            PlyRow& row = rows.rows.emplace_back();
+            double evalAfter;
+            evaluatePly(i, autoQueen, position, boardInSync, row.fenAfter, evalAfter, legalMovesAfter);
+
+            // Check if king is in check after the move
+            bool isCheckAfter = false;
+            if (moveValid) {
+                // After the move, check if the opponent's king is in check
+                isCheckAfter = position.isInCheck(!isWhiteMove);
+            }
+
+            PlyClock clock = PlyClock::of(game, i);
+
+            bool kingSideCastle = position.kingSideCastle();
+            bool queenSideCastle = position.queenSideCastle();
+
+            row.ply = static_cast<uint32_t>(i + 1);
+            row.kingSideCastle = kingSideCastle;
+            row.queenSideCastle = queenSideCastle;
+            row.checkBefore = isCheckBefore;
+            row.checkAfter = isCheckAfter;
+            row.evalBefore = evalBefore;
+            row.evalAfter = evalAfter;
+            row.timeRemaining = clock.timeRemaining;
+            row.timeSpentOnMoveBeforeIt = clock.timeSpentOnMoveBeforeIt;
+            row.legalMovesBefore = legalMovesBefore;
+            row.legalMovesAfter = legalMovesAfter;
+            row.timeSpent = clock.timeSpent;
+            std::strcpy(row.fenBefore, fenBefore);
+
+            // Update for next iteration
+            evalBefore = evalAfter;
+            evalAfter = 0.0;
+            isCheckBefore = isCheckAfter;
+            fenBefore = row.fenAfter;
+            legalMovesBefore = legalMovesAfter;
+            legalMovesAfter = 20;
+            if (!tuning) pipelineStats.plies++;
+        }
+        if (!tuning) pipelineStats.games++;
+    }
+};
@@ -0,0 +1,279 @@
+﻿// GameFileParser.h : Reads the game_information<N>.json files.
+
+#pragma once
+
+#include <charconv>
+#include <iostream>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "ChessPosition.h"
+#include "MappedFile.h"
+
+// One game, viewing the storage of the GameArena it was parsed into.
+struct GameData {
+    std::string_view gameId;
+    std::span<const Move> moves;          // InvalidMove where the record holds something else
+    std::span<const int> whiteTimestamps;
+    std::span<const int> blackTimestamps;
+};
+
+// Every game of one file: ids, moves and clock readings each in one contiguous array, and a GameData
+// view per game. A file costs a handful of allocations instead of several per game. Moving the arena
+// keeps the views valid; it can't be copied.
+class GameArena {
+private:
+    friend class GameFileParser;
+
+    std::vector<char> ids;
+    std::vector<Move> moveData;
+    std::vector<int> clockData;
+    std::vector<GameData> views;
+
+    // Where each game's data starts in the arrays while they may still move
+    struct Extent {
+        size_t id, idLength;
+        size_t moves, moveCount;
+        size_t white, whiteCount;
+        size_t black, blackCount;
+    };
+    std::vector<Extent> extents;
+
+    void clear() {
+        ids.clear();
+        moveData.clear();
+        clockData.clear();
+        views.clear();
+        extents.clear();
+    }
+
+    // Points the views at the arrays once they are complete.
+    void finish() {
+        views.resize(extents.size());
+        for (size_t i = 0; i < extents.size(); i++) {
+            const Extent& e = extents[i];
+            views[i].gameId = std::string_view(ids.data() + e.id, e.idLength);
+            views[i].moves = std::span<const Move>(moveData.data() + e.moves, e.moveCount);
+            views[i].whiteTimestamps = std::span<const int>(clockData.data() + e.white, e.whiteCount);
+            views[i].blackTimestamps = std::span<const int>(clockData.data() + e.black, e.blackCount);
+        }
+        extents.clear();
+        extents.shrink_to_fit();
+    }
+
+public:
+    GameArena() = default;
+    GameArena(GameArena&&) = default;
+    GameArena& operator=(GameArena&&) = default;
+    GameArena(const GameArena&) = delete;
+    GameArena& operator=(const GameArena&) = delete;
+
+    const std::vector<GameData>& games() const {
+        return views;
+    }
+
+    size_t size() const {
+        return views.size();
+    }
+
+    bool empty() const {
+        return views.empty();
+    }
+
+    // Heap memory held, in bytes.
+    size_t memoryBytes() const {
+        return ids.capacity() + moveData.capacity() * sizeof(Move) + clockData.capacity() * sizeof(int) +
+            views.capacity() * sizeof(GameData) + extents.capacity() * sizeof(Extent);
+    }
+};
+
+// Single-pass parser over the memory-mapped file. The file is one JSON object mapping game ids to
+// objects with "moveListArray", "whiteMoveTimestampsArray" and "blackMoveTimestampsArray"; keys may
+// come in any order, other keys are skipped and any JSON whitespace is accepted. Values are decoded
+// straight from the mapping into the arena's arrays, moves packed into 16-bit Moves.
+class GameFileParser {
+private:
+    const char* p = nullptr;
+    const char* end = nullptr;
+    GameArena* arena = nullptr;
+
+    void skipWhitespace() {
+        while (p < end && (*p == ' ' || *p == '\n' || *p == '\r' || *p == '\t')) p++;
+    }
+
+    bool consume(char c) {
+        skipWhitespace();
+        if (p < end && *p == c) {
+            p++;
+            return true;
+        }
+        return false;
+    }
+
+    // Reads a string token and points `value` at its raw contents inside the mapping.
+    bool readString(std::string_view& value) {
+        skipWhitespace();
+        if (p >= end || *p != '"') return false;
+        const char* start = ++p;
+        while (p < end && *p != '"') {
+            if (*p == '\\') p++;
+            p++;
+        }
+        if (p >= end) return false;
+        value = std::string_view(start, static_cast<size_t>(p - start));
+        p++;
+        return true;
+    }
+
+    bool skipValue() {
+        skipWhitespace();
+        if (p >= end) return false;
+
+        std::string_view ignored;
+        switch (*p) {
+        case '"':
+            return readString(ignored);
+        case '[':
+            return readArray([this]() { return skipValue(); });
+        case '{':
+            p++;
+            if (consume('}')) return true;
+            do {
+                if (!readString(ignored) || !consume(':') || !skipValue()) return false;
+            } while (consume(','));
+            return consume('}');
+        default: // number, true, false, null
+            while (p < end && *p != ',' && *p != ']' && *p != '}' && *p != ' ' && *p != '\n' && *p != '\r' && *p != '\t') p++;
+            return true;
+        }
+    }
+
+    // Calls `element` once per array element; `element` must consume exactly one value.
+    template <typename ElementReader>
+    bool readArray(ElementReader element) {
+        if (!consume('[')) return false;
+        if (consume(']')) return true;
+        do {
+            if (!element()) return false;
+        } while (consume(','));
+        return consume(']');
+    }
+
+    // Some games have null instead of an array; anything that isn't an array is skipped.
+    bool isArray() {
+        skipWhitespace();
+        return p < end && *p == '[';
+    }
+
+    bool readMoves(size_t& start, size_t& count) {
+        if (!isArray()) return skipValue();
+        start = arena->moveData.size();
+        bool ok = readArray([&]() {
+            std::string_view move;
+            if (!readString(move)) return false;
+            arena->moveData.push_back(parseUciMove(move));
+            return true;
+        });
+        count = arena->moveData.size() - start;
+        return ok;
+    }
+
+    // Clock readings are written as strings ("1809") but plain numbers are accepted too.
+    bool readTimestamps(size_t& start, size_t& count) {
+        if (!isArray()) return skipValue();
+        start = arena->clockData.size();
+        bool ok = readArray([&]() {
+            skipWhitespace();
+            std::string_view digits;
+            if (p < end && *p == '"') {
+                if (!readString(digits)) return false;
+            }
+            else {
+                const char* start = p;
+                if (!skipValue()) return false;
+                digits = std::string_view(start, static_cast<size_t>(p - start));
+            }
+
+            int value = 0;
+            auto result = std::from_chars(digits.data(), digits.data() + digits.size(), value);
+            if (result.ec != std::errc()) return false;
+            arena->clockData.push_back(value);
+            return true;
+        });
+        count = arena->clockData.size() - start;
+        return ok;
+    }
+
+    bool readGame(GameArena::Extent& game) {
+        if (!consume('{')) return false;
+        if (consume('}')) return true;
+        do {
+            std::string_view key;
+            if (!readString(key) || !consume(':')) return false;
+
+            bool ok;
+            if (key == "moveListArray") ok = readMoves(game.moves, game.moveCount);
+            else if (key == "whiteMoveTimestampsArray") ok = readTimestamps(game.white, game.whiteCount);
+            else if (key == "blackMoveTimestampsArray") ok = readTimestamps(game.black, game.blackCount);
+            else ok = skipValue();
+            if (!ok) return false;
+        } while (consume(','));
+        return consume('}');
+    }
+
+public:
+    // Fills `games` with every game of the file that has at least one move, replacing what it held.
+    // Returns false, with a message on stdout, if the file can't be opened or is malformed; games
+    // before the error are still kept.
+    bool parse(const std::string& filename, GameArena& games) {
+        games.clear();
+        MappedFile file;
+        if (!file.openReadOnly(filename)) {
+            std::cout << "Error: Could not open " << filename << std::endl;
+            return false;
+        }
+
+        p = file.data();
+        end = p + file.size();
+        arena = &games;
+        if (end - p >= 3 && std::string_view(p, 3) == "\xEF\xBB\xBF") p += 3; // UTF-8 byte order mark
+
+        // A ply takes about 25 bytes of JSON: the move and its clock reading
+        arena->moveData.reserve(file.size() / 25);
+        arena->clockData.reserve(file.size() / 25);
+
+        bool ok = consume('{');
+        if (ok && !consume('}')) {
+            do {
+                GameArena::Extent game = {};
+                size_t movesBefore = arena->moveData.size();
+                size_t clocksBefore = arena->clockData.size();
+                std::string_view gameId;
+                if (!readString(gameId) || !consume(':') || !readGame(game)) {
+                    ok = false;
+                    break;
+                }
+                if (game.moveCount == 0) {
+                    arena->moveData.resize(movesBefore);
+                    arena->clockData.resize(clocksBefore);
+                    continue;
+                }
+                game.id = arena->ids.size();
+                game.idLength = gameId.size();
+                arena->ids.insert(arena->ids.end(), gameId.begin(), gameId.end());
+                arena->extents.push_back(game);
+            } while (consume(','));
+            ok = ok && consume('}');
+        }
+
+        if (!ok) {
+            std::cout << "Error: Malformed game file " << filename << " near byte " << (p - file.data()) << std::endl;
+        }
+        games.finish();
+        p = end = nullptr;
+        arena = nullptr;
+        return ok;
+    }
+};
@@ -0,0 +1,117 @@
+﻿// GameFileReader.h : Finds the game_information<N>.json files and parses them on a reader thread,
+// ahead of the analysis.
+
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "GameFileParser.h"
+
+// The games of one input file.
+struct GameBatch {
+    std::string inputFile;
+    GameArena arena; // empty if the file could not be read or held no games
+};
+
+// Parses the files in order into a queue of at most `capacity` batches. When the analysis falls behind
+// the reader waits, so only `capacity` parsed files are held besides the one being parsed and the one
+// being analyzed.
+class GameFileReader {
+private:
+    std::vector<std::string> files;
+    size_t capacity;
+    std::deque<GameBatch> batches;
+    std::mutex mutex;
+    std::condition_variable batchReady;
+    std::condition_variable spaceFree;
+    bool finished = false; // every file has been queued
+    bool stopping = false;
+    std::thread reader;
+
+    void run() {
+        for (const std::string& file : files) {
+            GameBatch batch;
+            batch.inputFile = file;
+            GameFileParser().parse(file, batch.arena);
+
+            std::unique_lock<std::mutex> lock(mutex);
+            spaceFree.wait(lock, [this]() { return batches.size() < capacity || stopping; });
+            if (stopping) return;
+            batches.push_back(std::move(batch));
+            batchReady.notify_one();
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        finished = true;
+        batchReady.notify_one();
+    }
+
+public:
+    // Starts reading `files` right away.
+    explicit GameFileReader(std::vector<std::string> files, size_t capacity = 2)
+        : files(std::move(files)), capacity(std::max<size_t>(1, capacity)) {
+        reader = std::thread(&GameFileReader::run, this);
+    }
+
+    GameFileReader(const GameFileReader&) = delete;
+    GameFileReader& operator=(const GameFileReader&) = delete;
+
+    ~GameFileReader() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        spaceFree.notify_one();
+        reader.join();
+    }
+
+    // The game_information<N>.json files in `directory`, ordered by N. Names are given relative to the
+    // current directory, as the resume marker records them.
+    static std::vector<std::string> discover(const std::string& directory = ".") {
+        const std::string prefix = "game_information";
+        const std::string suffix = ".json";
+        std::vector<std::pair<unsigned long long, std::string>> found;
+
+        std::error_code error;
+        for (const auto& entry : std::filesystem::directory_iterator(directory, error)) {
+            std::string name = entry.path().filename().string();
+            if (name.size() <= prefix.size() + suffix.size() || name.compare(0, prefix.size(), prefix) != 0 ||
+                name.compare(name.size() - suffix.size(), suffix.size(), suffix) != 0) continue;
+
+            std::string number = name.substr(prefix.size(), name.size() - prefix.size() - suffix.size());
+            if (number.size() > 18 || number.find_first_not_of("0123456789") != std::string::npos) continue;
+            if (!entry.is_regular_file(error)) continue;
+
+            std::string path = directory == "." ? name : entry.path().string();
+            found.emplace_back(std::stoull(number), path);
+        }
+
+        std::sort(found.begin(), found.end());
+        std::vector<std::string> files;
+        for (auto& file : found) files.push_back(std::move(file.second));
+        return files;
+    }
+
+    size_t fileCount() const {
+        return files.size();
+    }
+
+    // Waits for the next file's games. Returns false once every file has been handed out.
+    bool next(GameBatch& batch) {
+        std::unique_lock<std::mutex> lock(mutex);
+        batchReady.wait(lock, [this]() { return !batches.empty() || finished; });
+        if (batches.empty()) return false;
+        batch = std::move(batches.front());
+        batches.pop_front();
+        spaceFree.notify_one();
+        return true;
+    }
+};
@@ -0,0 +1,138 @@
+﻿// MappedFile.h : Maps a file into memory, read-only or shared read-write.
+
+#pragma once
+
+#include <string>
+#include <cstddef>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+class MappedFile {
+private:
+    char* mapped = nullptr;
+    size_t mappedSize = 0;
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#else
+    int fd = -1;
+#endif
+
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile() {
+        close();
+    }
+
+    // Maps an existing file read-only.
+    bool openReadOnly(const std::string& path) {
+        close();
+#ifdef _WIN32
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) return false;
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(file, &size)) {
+            close();
+            return false;
+        }
+        mappedSize = static_cast<size_t>(size.QuadPart);
+        if (mappedSize == 0) return true;
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping) mapped = static_cast<char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+#else
+        fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            close();
+            return false;
+        }
+        mappedSize = static_cast<size_t>(st.st_size);
+        if (mappedSize == 0) return true;
+        void* p = mmap(nullptr, mappedSize, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED) {
+            mapped = static_cast<char*>(p);
+            madvise(mapped, mappedSize, MADV_SEQUENTIAL);
+        }
+#endif
+        if (!mapped) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    // Maps `path` read-write and shared with every other process mapping it, creating the file
+    // and growing it to `size` bytes if needed. New space reads as zeros.
+    bool openShared(const std::string& path, size_t size) {
+        close();
+#ifdef _WIN32
+        file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE,
+            nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) return false;
+        LARGE_INTEGER mapSize;
+        mapSize.QuadPart = static_cast<LONGLONG>(size);
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READWRITE, mapSize.HighPart, mapSize.LowPart, nullptr);
+        if (mapping) mapped = static_cast<char*>(MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size));
+#else
+        fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || (static_cast<size_t>(st.st_size) < size && ftruncate(fd, static_cast<off_t>(size)) != 0)) {
+            close();
+            return false;
+        }
+        void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (p != MAP_FAILED) mapped = static_cast<char*>(p);
+#endif
+        if (!mapped) {
+            close();
+            return false;
+        }
+        mappedSize = size;
+        return true;
+    }
+
+    // Starts writing dirty pages back to disk without waiting for it.
+    void flush() {
+        if (!mapped) return;
+#ifdef _WIN32
+        FlushViewOfFile(mapped, 0);
+#else
+        msync(mapped, mappedSize, MS_ASYNC);
+#endif
+    }
+
+    void close() {
+#ifdef _WIN32
+        if (mapped) UnmapViewOfFile(mapped);
+        if (mapping) CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+        mapping = nullptr;
+        file = INVALID_HANDLE_VALUE;
+#else
+        if (mapped) munmap(mapped, mappedSize);
+        if (fd >= 0) ::close(fd);
+        fd = -1;
+#endif
+        mapped = nullptr;
+        mappedSize = 0;
+    }
+
+    char* data() const {
+        return mapped;
+    }
+
+    size_t size() const {
+        return mappedSize;
+    }
+};
@@ -0,0 +1,254 @@
+﻿// MockEngine.cpp : A stand-in for Stockfish that speaks enough UCI for the analyzer.
+//
+// Scores and best moves are derived from the position's Zobrist hash, so every run gives the same
+// output, and searches can be slowed down to simulate engine time: the latency (in microseconds per
+// "go depth") comes from the MOCK_ENGINE_LATENCY_US environment variable or "setoption name Latency".
+// Supported: uci, isready, ucinewgame, setoption, position (startpos | fen) [moves ...],
+// go perft N, go depth N, stop, d, quit.
+
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include "ChessPosition.h"
+
+class MockEngine {
+private:
+    ChessPosition position;
+    std::mutex outputMutex;
+    std::thread search;
+    std::atomic<bool> stopRequested = false;
+    long long latencyUs = 0;
+
+    void send(const std::string& text) {
+        std::lock_guard<std::mutex> lock(outputMutex);
+        std::fwrite(text.data(), 1, text.size(), stdout);
+        std::fputc('\n', stdout);
+        std::fflush(stdout);
+    }
+
+    void finishSearch() {
+        if (search.joinable()) search.join();
+        stopRequested = false;
+    }
+
+    static uint64_t mix(uint64_t x) {
+        x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+        return x ^ (x >> 31);
+    }
+
+    void setPosition(std::istringstream& args) {
+        std::string token;
+        args >> token;
+        if (token == "startpos") {
+            position.resetToStartingPosition();
+            args >> token;
+        }
+        else if (token == "fen") {
+            std::string fen;
+            while (args >> token && token != "moves") fen += token + " ";
+            if (!position.setFen(fen)) return;
+        }
+        else {
+            return;
+        }
+
+        // Like Stockfish, stop at the first illegal move and keep the position reached so far.
+        while (args >> token) {
+            Move moves[ChessPosition::MaxMoves];
+            int count = position.generateLegalMoves(moves);
+            bool legal = false;
+            for (int i = 0; i < count && !legal; i++) legal = moveToUci(moves[i]) == token;
+            if (!legal) break;
+            position.makeMove(token);
+        }
+    }
+
+    static uint64_t perft(ChessPosition& position, int depth) {
+        Move moves[ChessPosition::MaxMoves];
+        int count = position.generateLegalMoves(moves);
+        if (depth <= 1) return count;
+
+        uint64_t nodes = 0;
+        UndoInfo undo;
+        for (int i = 0; i < count; i++) {
+            if (!position.makeMove(moves[i], undo)) continue;
+            nodes += perft(position, depth - 1);
+            position.unmakeMove(undo);
+        }
+        return nodes;
+    }
+
+    // Laid out as Stockfish does it: its "info string" header (which has a colon of its own), a
+    // "move: nodes" line per legal move, then the total between blank lines.
+    void goPerft(int depth) {
+        Move moves[ChessPosition::MaxMoves];
+        int count = position.generateLegalMoves(moves);
+        uint64_t total = 0;
+        std::ostringstream out;
+        out << "info string Available processors: 0\ninfo string Using 1 thread\n";
+        for (int i = 0; i < count; i++) {
+            UndoInfo undo;
+            if (!position.makeMove(moves[i], undo)) continue;
+            uint64_t nodes = depth <= 1 ? 1 : perft(position, depth - 1);
+            position.unmakeMove(undo);
+            total += nodes;
+            out << moveToUci(moves[i]) << ": " << nodes << "\n";
+        }
+        out << "\nNodes searched: " << total << "\n";
+        send(out.str());
+    }
+
+    // Reports one "info depth" line per depth and then the best move, spreading the latency over the depths.
+    void goDepth(int depth, ChessPosition root, long long latency) {
+        auto start = std::chrono::steady_clock::now();
+        Move moves[ChessPosition::MaxMoves];
+        int count = root.generateLegalMoves(moves);
+        uint64_t key = root.hash();
+
+        if (count == 0) {
+            bool mated = root.isInCheck(root.isWhiteToMove());
+            send(mated ? "info depth 0 score mate 0" : "info depth 0 score cp 0");
+            send("bestmove (none)");
+            return;
+        }
+
+        std::string best;
+        for (int d = 1; d <= std::max(depth, 1); d++) {
+            auto due = start + std::chrono::microseconds(latency * d / std::max(depth, 1));
+            while (!stopRequested && std::chrono::steady_clock::now() < due) {
+                std::this_thread::sleep_until(std::min(due, std::chrono::steady_clock::now() + std::chrono::milliseconds(1)));
+            }
+
+            uint64_t noise = mix(key + d);
+            int score = static_cast<int>(mix(key) % 401) - 200 + static_cast<int>(noise % 21) - 10;
+            best = moveToUci(moves[noise % count]);
+            uint64_t nodes = 1000ULL * d + key % 1000;
+            long long elapsedMs = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+            // nps from the scheduled latency rather than the clock, so that runs write identical rows
+            long long scheduledMs = latency * d / std::max(depth, 1) / 1000;
+            std::ostringstream info;
+            info << "info depth " << d << " seldepth " << d + 2 << " multipv 1 score cp " << score
+                << " nodes " << nodes << " nps " << nodes * 1000 / (scheduledMs + 1)
+                << " hashfull 0 tbhits 0 time " << elapsedMs << " pv " << best;
+            send(info.str());
+
+            if (stopRequested) break;
+        }
+        send("bestmove " + best);
+    }
+
+    void display() {
+        std::ostringstream out;
+        out << "\n +---+---+---+---+---+---+---+---+\n";
+        char fen[ChessPosition::FenBufferSize];
+        position.writeFen(fen);
+
+        // Expand the placement field of the FEN back into squares.
+        int rank = 8;
+        out << " |";
+        for (const char* p = fen; *p != ' '; p++) {
+            if (*p == '/') {
+                out << " " << rank-- << "\n +---+---+---+---+---+---+---+---+\n |";
+            }
+            else if (*p >= '1' && *p <= '8') {
+                for (int i = 0; i < *p - '0'; i++) out << "   |";
+            }
+            else {
+                out << " " << *p << " |";
+            }
+        }
+        out << " " << rank << "\n +---+---+---+---+---+---+---+---+\n";
+        out << "   a   b   c   d   e   f   g   h\n\n";
+
+        char key[17];
+        std::snprintf(key, sizeof(key), "%016" PRIX64, position.hash());
+        out << "Fen: " << fen << "\nKey: " << key << "\nCheckers: ";
+
+        const BoardBitboards& bb = position.bitboards();
+        int us = position.isWhiteToMove() ? 0 : 1;
+        if (bb.kingSquare[us] >= 0) {
+            for (Bitboard b = bb.attackersTo(bb.kingSquare[us], us ^ 1, bb.occupied); b; b &= b - 1) {
+                int square = lowestSquare(b);
+                out << char('a' + square % 8) << char('1' + square / 8) << " ";
+            }
+        }
+        send(out.str());
+    }
+
+public:
+    MockEngine() {
+        if (const char* latency = std::getenv("MOCK_ENGINE_LATENCY_US")) latencyUs = std::atoll(latency);
+    }
+
+    int run() {
+        std::string line;
+        while (std::getline(std::cin, line)) {
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            std::istringstream args(line);
+            std::string command;
+            args >> command;
+
+            if (command == "quit") {
+                break;
+            }
+            else if (command == "stop") {
+                stopRequested = true;
+                finishSearch();
+            }
+            else if (command == "isready") {
+                send("readyok");
+            }
+            else if (command == "uci") {
+                send("id name MockEngine\nid author CMakeProject3\n\n"
+                    "option name Threads type spin default 1 min 1 max 1024\n"
+                    "option name Hash type spin default 16 min 1 max 33554432\n"
+                    "option name Latency type spin default 0 min 0 max 100000000\n"
+                    "uciok");
+            }
+            else if (command == "setoption") {
+                std::string token, name, value;
+                args >> token >> name >> token >> value;
+                if (name == "Latency" && !value.empty()) latencyUs = std::atoll(value.c_str());
+            }
+            else if (command == "ucinewgame" || command.empty()) {
+            }
+            else {
+                // Everything else needs the previous search to be over first.
+                finishSearch();
+                if (command == "position") {
+                    setPosition(args);
+                }
+                else if (command == "d") {
+                    display();
+                }
+                else if (command == "go") {
+                    std::string mode;
+                    int depth = 1;
+                    args >> mode >> depth;
+                    if (mode == "perft") goPerft(depth);
+                    else search = std::thread(&MockEngine::goDepth, this, depth, position, latencyUs);
+                }
+                else {
+                    send("Unknown command: '" + line + "'. Type help for more information.");
+                }
+            }
+        }
+
+        stopRequested = true;
+        finishSearch();
+        return 0;
+    }
+};
+
+int main() {
+    return MockEngine().run();
+}
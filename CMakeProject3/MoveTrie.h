@@ -0,0 +1,80 @@
+﻿// MoveTrie.h : The move sequences of a batch of games as a trie, so a position reached by a shared
+// opening is analyzed once for every game that reaches it.
+
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "GameFileParser.h"
+
+class MoveTrie {
+public:
+    static constexpr uint32_t None = UINT32_MAX;
+
+    struct Node {
+        uint32_t firstChild = None;
+        uint32_t nextSibling = None;
+        uint32_t game = 0;        // a game (index into the batch) whose moves lead here...
+        uint32_t ply = 0;         // ...and how many of them: the move into this node is its moves[ply - 1]
+    };
+
+private:
+    const std::vector<GameData>* games = nullptr;
+    std::vector<size_t> batch;
+    std::vector<Node> nodeList;         // node 0 is the starting position; parents come before their children
+    std::vector<uint32_t> paths;        // for each game of the batch in turn, the node reached after each ply
+    std::vector<size_t> pathStarts;
+
+public:
+    // Builds the trie of games[indices[k]] for every k; `games` must outlive the trie.
+    void build(const std::vector<GameData>& allGames, const std::vector<size_t>& indices) {
+        games = &allGames;
+        batch = indices;
+        nodeList.assign(1, Node());
+        paths.clear();
+        pathStarts.assign(1, 0);
+
+        for (size_t k = 0; k < batch.size(); k++) {
+            std::span<const Move> moves = allGames[batch[k]].moves;
+            uint32_t current = 0;
+            for (size_t ply = 1; ply <= moves.size(); ply++) {
+                uint32_t child = nodeList[current].firstChild;
+                while (child != None && move(child) != moves[ply - 1]) child = nodeList[child].nextSibling;
+
+                if (child == None) {
+                    child = static_cast<uint32_t>(nodeList.size());
+                    Node& node = nodeList.emplace_back();
+                    node.nextSibling = nodeList[current].firstChild;
+                    node.game = static_cast<uint32_t>(k);
+                    node.ply = static_cast<uint32_t>(ply);
+                    nodeList[current].firstChild = child;
+                }
+                paths.push_back(child);
+                current = child;
+            }
+            pathStarts.push_back(paths.size());
+        }
+    }
+
+    size_t size() const {
+        return nodeList.size();
+    }
+
+    // The move that leads into `index` (not the root).
+    Move move(uint32_t index) const {
+        const Node& node = nodeList[index];
+        return (*games)[batch[node.game]].moves[node.ply - 1];
+    }
+
+    // The nodes the k-th game of the batch passes through, one per ply.
+    std::span<const uint32_t> path(size_t k) const {
+        return std::span<const uint32_t>(paths.data() + pathStarts[k], pathStarts[k + 1] - pathStarts[k]);
+    }
+
+    // Plies over all games, each of which the trie maps to one of the size() - 1 positions.
+    size_t plyCount() const {
+        return paths.size();
+    }
+};
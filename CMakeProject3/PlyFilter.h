@@ -0,0 +1,129 @@
+﻿// PlyFilter.h : Picks the plies that get an engine search, from the game's clocks and our own board alone.
+
+#pragma once
+
+#include <cstddef>
+#include <span>
+#include <vector>
+
+#include "ChessPosition.h"
+#include "GameFileParser.h"
+
+// The clock features of one ply, scaled the way the rows carry them (see PlyRow).
+struct PlyClock {
+    double timeRemaining = 0;
+    double timeSpentOnMoveBeforeIt = 0;
+    double timeSpent = 0;
+    bool recorded = false; // false past the end of the mover's clock readings, where the values are all 0
+
+    // A clock reading, or 0 past the end of a record that has fewer readings than moves. The arrays of all
+    // games sit back to back in the arena, so reading past the end would pick up the next game's clock.
+    static int clockAt(std::span<const int> timestamps, size_t index) {
+        return index < timestamps.size() ? timestamps[index] : 0;
+    }
+
+    // The clocks of ply `i` of `game`.
+    static PlyClock of(const GameData& game, size_t i) {
+        bool isWhiteMove = (i % 2 == 0);
+        double timeSpent = 0;
+        int timeRemaining = 0;
+        double timeSpentOnMoveBeforeIt = 0;
+
+        if (isWhiteMove && i / 2 < game.whiteTimestamps.size()) {
+            size_t whiteIndex = i / 2;
+
+            if (whiteIndex == 0) {
+                timeSpent = 1800 - clockAt(game.whiteTimestamps, whiteIndex + 1);
+            }
+            else {
+                timeSpent = game.whiteTimestamps[whiteIndex - 1] - game.whiteTimestamps[whiteIndex];
+            }
+
+            if (whiteIndex == 0) {
+                timeRemaining = game.whiteTimestamps[0];
+            }
+            else if (whiteIndex < game.whiteTimestamps.size()) {
+                timeRemaining = game.whiteTimestamps[whiteIndex];
+            }
+
+            if (whiteIndex < 1) {
+                timeSpentOnMoveBeforeIt = 0;
+            }
+            else {
+                timeSpentOnMoveBeforeIt = clockAt(game.blackTimestamps, whiteIndex - 1) - clockAt(game.blackTimestamps, whiteIndex);
+            }
+        }
+        else if (!isWhiteMove && i / 2 < game.blackTimestamps.size()) {
+            size_t blackIndex = i / 2;
+
+            if (blackIndex == 0) {
+                timeSpent = 1800 - game.blackTimestamps[blackIndex];
+            }
+            else {
+                timeSpent = game.blackTimestamps[blackIndex - 1] - game.blackTimestamps[blackIndex];
+            }
+
+            if (blackIndex == 0) {
+                timeRemaining = game.blackTimestamps[0];
+            }
+            else if (blackIndex < game.blackTimestamps.size()) {
+                timeRemaining = game.blackTimestamps[blackIndex];
+            }
+
+            if (blackIndex < 1) {
+                timeSpentOnMoveBeforeIt = 0;
+            }
+            else {
+                timeSpentOnMoveBeforeIt = clockAt(game.whiteTimestamps, blackIndex - 1) - clockAt(game.whiteTimestamps, blackIndex);
+            }
+        }
+
+        timeSpent = timeSpent * 0.1;
+        timeSpentOnMoveBeforeIt = timeSpentOnMoveBeforeIt * 0.1;
+
+        PlyClock clock;
+        clock.recorded = i / 2 < (isWhiteMove ? game.whiteTimestamps.size() : game.blackTimestamps.size());
+        clock.timeRemaining = timeRemaining * 0.1;
+        clock.timeSpentOnMoveBeforeIt = timeSpentOnMoveBeforeIt * 0.1;
+        clock.timeSpent = timeSpent;
+        return clock;
+    }
+};
+
+// With no criterion set every ply is searched. Otherwise only the plies that meet at least one are, each
+// together with the ply before it, so that its evalBefore comes from a search too. The other plies keep
+// the features our own board gives (FENs, legal moves, checks, castling, clocks) but no evaluation.
+struct PlyFilter {
+    double lowClockSeconds = 0;  // the mover has at most this much time left after the move
+    double longThinkSeconds = 0; // the move took at least this long
+    bool checks = false;         // the move gives check or gets out of one
+    size_t everyNth = 0;         // plies N, 2N, 3N...
+
+    bool enabled() const {
+        return lowClockSeconds > 0 || longThinkSeconds > 0 || checks || everyNth > 0;
+    }
+
+    // Sets selected[i] to 1 for every ply i of `game` that is to be searched, and to 0 for the rest.
+    void select(const GameData& game, std::vector<char>& selected) const {
+        size_t plies = game.moves.size();
+        selected.assign(plies, enabled() ? 0 : 1);
+        if (!enabled()) return;
+
+        ChessPosition position;
+        bool checkBefore = position.isInCheck(true);
+        for (size_t i = 0; i < plies; i++) {
+            bool checkAfter = position.makeMove(game.moves[i]) && position.isInCheck(i % 2 != 0);
+            PlyClock clock = PlyClock::of(game, i);
+
+            bool pick = (lowClockSeconds > 0 && clock.recorded && clock.timeRemaining <= lowClockSeconds) ||
+                (longThinkSeconds > 0 && clock.recorded && clock.timeSpent >= longThinkSeconds) ||
+                (checks && (checkBefore || checkAfter)) ||
+                (everyNth > 0 && (i + 1) % everyNth == 0);
+            if (pick) {
+                selected[i] = 1;
+                if (i > 0) selected[i - 1] = 1;
+            }
+            checkBefore = checkAfter;
+        }
+    }
+};
@@ -0,0 +1,50 @@
+﻿// PlyRow.h : One labeled ply, the unit handed from the analyzer to the output stage.
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "ChessPosition.h"
+
+// What the engine's search of a position found besides its score. All zero, with no moves, when the
+// position was answered from the evaluation cache or not searched at all.
+struct SearchDetails {
+    static constexpr size_t MaxPvLength = 32;
+
+    uint8_t seldepth = 0;
+    uint8_t pvLength = 0;
+    Move bestMove = InvalidMove;
+    uint64_t nodes = 0;
+    uint64_t nps = 0;
+    Move pv[MaxPvLength] = {}; // the first pvLength moves of the principal variation
+};
+
+// The values of one output row, already scaled the way they are written out.
+// The FENs are kept inline so that building a row never allocates.
+struct PlyRow {
+    uint32_t ply = 0;
+    bool kingSideCastle = false;
+    bool queenSideCastle = false;
+    bool checkBefore = false;
+    bool checkAfter = false;
+    double evalBefore = 0;
+    double evalAfter = 0;
+    double timeRemaining = 0;           // seconds
+    double timeSpentOnMoveBeforeIt = 0; // seconds * 0.1, as in the original output
+    double legalMovesBefore = 0;
+    double legalMovesAfter = 0;
+    double timeSpent = 0;               // seconds
+    uint8_t depthAfter = 0;             // the depth evalAfter was searched to
+    int8_t mateAfter = 0;               // moves to mate found after the move (negative when being mated), 0 if none
+    SearchDetails searchAfter;          // the rest of what the search after the move found
+    char fenBefore[ChessPosition::FenBufferSize] = {};
+    char fenAfter[ChessPosition::FenBufferSize] = {};
+};
+
+// All rows of one game; games are always written as a whole.
+struct GameRows {
+    std::string gameId;
+    std::vector<PlyRow> rows;
+};
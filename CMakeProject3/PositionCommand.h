@@ -0,0 +1,76 @@
+﻿// PositionCommand.h : Builds the "position" command sent to the engine before each search.
+
+#pragma once
+
+#include <string>
+
+#include "ChessPosition.h"
+
+// Replaying the whole game with "position startpos moves ..." costs O(ply) to build, send and
+// replay on every ply. In incremental mode the command is instead the FEN after the last capture
+// or pawn move plus the moves played since. No position before that point can ever repeat, so the
+// engine sees exactly the history a full replay gives it, while the command length is bounded by
+// the fifty-move rule instead of growing with the game.
+class PositionCommand {
+private:
+    bool incremental;
+    std::string command;
+    std::string allMoves;         // every move so far, for full replays
+    std::string anchorFen;        // position after the last irreversible move
+    std::string movesSinceAnchor;
+
+public:
+    explicit PositionCommand(bool incremental = true) : incremental(incremental) {
+        command.reserve(256);
+        anchorFen.reserve(ChessPosition::FenBufferSize);
+        reset();
+    }
+
+    // Back to the starting position of a new game. Keeps the buffers, so later games don't allocate.
+    void reset() {
+        allMoves.clear();
+        movesSinceAnchor.clear();
+        anchorFen.clear();
+        command.assign("position startpos moves");
+    }
+
+    // Records `move`, which has just been applied to `position`, and returns the command for the new position.
+    // `autoQueen` adds the promotion piece the game records leave out. Once our board has lost track of the
+    // game (`boardInSync` false) its FEN can't be used and the command falls back to the full move list.
+    const std::string& afterMove(Move move, bool autoQueen, const ChessPosition& position, bool boardInSync) {
+        char uci[7] = { ' ' };
+        char* uciEnd = writeUci(move, uci + 1);
+        if (autoQueen) *uciEnd++ = 'q';
+        std::string_view text(uci, static_cast<size_t>(uciEnd - uci)); // with the leading space
+        allMoves += text;
+
+        if (!incremental || !boardInSync) {
+            command.assign("position startpos moves");
+            command += allMoves;
+            return command;
+        }
+
+        if (position.getHalfmoveClock() == 0) {
+            position.writeFen(anchorFen);
+            movesSinceAnchor.clear();
+        }
+        else {
+            movesSinceAnchor += text;
+        }
+
+        if (anchorFen.empty()) {
+            // No irreversible move yet: replaying from startpos is just as short.
+            command.assign("position startpos moves");
+            command += movesSinceAnchor;
+        }
+        else {
+            command.assign("position fen ");
+            command += anchorFen;
+            if (!movesSinceAnchor.empty()) {
+                command += " moves";
+                command += movesSinceAnchor;
+            }
+        }
+        return command;
+    }
+};
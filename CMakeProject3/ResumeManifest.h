@@ -0,0 +1,172 @@
+﻿// ResumeManifest.h : Records which games are safely in the output so an interrupted run can resume.
+
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <unordered_set>
+#include <vector>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+// Two files live next to the output:
+//  - "<output>.manifest" gets a "gameId<TAB>outputSize" line per game, appended and fsynced only
+//    after the output holding that game has been fsynced. A torn last line is ignored.
+//  - "<output>.progress" names the input file being analyzed and the output size when it started.
+//    It is replaced atomically (temp file + rename) and removed once the file is done.
+// When a run finds the progress marker, it died mid-file: the output is cut back to the last size
+// the manifest vouches for, which drops the partial trailing rows of unrecorded games.
+class ResumeManifest {
+private:
+    std::string manifestPath;
+    std::string markerPath;
+    std::unordered_set<std::string> completed;
+    std::FILE* manifest = nullptr;
+
+    static bool syncFile(std::FILE* file) {
+        if (std::fflush(file) != 0) return false;
+#ifdef _WIN32
+        return _commit(_fileno(file)) == 0;
+#else
+        return ::fsync(fileno(file)) == 0;
+#endif
+    }
+
+    // Loads the complete lines of the manifest and returns the output size of the last one.
+    uint64_t load(uint64_t& validBytes) {
+        std::ifstream in(manifestPath, std::ios::binary);
+        std::string text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+        uint64_t committedSize = 0;
+        size_t lineStart = 0;
+        size_t lineEnd;
+        while ((lineEnd = text.find('\n', lineStart)) != std::string::npos) {
+            size_t tab = text.find('\t', lineStart);
+            uint64_t size = 0;
+            if (tab != std::string::npos && tab < lineEnd &&
+                std::from_chars(text.data() + tab + 1, text.data() + lineEnd, size).ec == std::errc()) {
+                completed.emplace(text, lineStart, tab - lineStart);
+                committedSize = size;
+            }
+            lineStart = lineEnd + 1;
+        }
+        validBytes = lineStart;
+        return committedSize;
+    }
+
+public:
+    ResumeManifest() = default;
+    ResumeManifest(const ResumeManifest&) = delete;
+    ResumeManifest& operator=(const ResumeManifest&) = delete;
+
+    ~ResumeManifest() {
+        if (manifest) std::fclose(manifest);
+    }
+
+    // Loads the state kept for `outputPath` and repairs the output after an interrupted run.
+    // Must be called before the output is opened for appending.
+    bool open(const std::string& outputPath) {
+        namespace fs = std::filesystem;
+        manifestPath = outputPath + ".manifest";
+        markerPath = outputPath + ".progress";
+        completed.clear();
+
+        std::error_code error;
+        uint64_t validBytes = 0;
+        uint64_t committedSize = load(validBytes);
+        uint64_t outputSize = fs::exists(outputPath, error) ? fs::file_size(outputPath, error) : 0;
+
+        if (outputSize < committedSize) {
+            // The output was cut short or replaced since; nothing in it or the manifest can be trusted,
+            // so both start again empty, along with any progress marker.
+            std::cerr << "Warning: " << outputPath << " is shorter than its manifest records, starting over" << std::endl;
+            completed.clear();
+            committedSize = 0;
+            validBytes = 0;
+            if (outputSize > 0) {
+                fs::resize_file(outputPath, 0, error);
+                if (error) return false;
+                outputSize = 0;
+            }
+            fs::remove(markerPath, error);
+        }
+
+        std::ifstream marker(markerPath);
+        std::string interruptedFile;
+        uint64_t startSize = 0;
+        if (marker >> std::quoted(interruptedFile) >> startSize) {
+            uint64_t keep = std::max(committedSize, startSize);
+            if (outputSize > keep) {
+                std::cout << "Resuming after an interrupted run on " << interruptedFile << ": dropping "
+                    << (outputSize - keep) << " bytes of unrecorded output" << std::endl;
+                fs::resize_file(outputPath, keep, error);
+                if (error) return false;
+            }
+        }
+        marker.close();
+
+        if (fs::exists(manifestPath, error) && fs::file_size(manifestPath, error) != validBytes) {
+            fs::resize_file(manifestPath, validBytes, error);
+            if (error) return false;
+        }
+
+        manifest = std::fopen(manifestPath.c_str(), "ab");
+        if (!manifest) return false;
+
+        if (!completed.empty()) {
+            std::cout << "Resuming: " << completed.size() << " games already analyzed" << std::endl;
+        }
+        return true;
+    }
+
+    // True the first time `gameId` is seen; false if it is already in the output or claimed earlier in this run.
+    bool claim(const std::string& gameId) {
+        return completed.insert(gameId).second;
+    }
+
+    // Records games whose rows are now durable in an output of `committedSize` bytes.
+    bool commit(const std::vector<std::string>& gameIds, uint64_t committedSize) {
+        std::string size = std::to_string(committedSize);
+        for (const std::string& gameId : gameIds) {
+            std::fputs(gameId.c_str(), manifest);
+            std::fputc('\t', manifest);
+            std::fputs(size.c_str(), manifest);
+            std::fputc('\n', manifest);
+        }
+        return syncFile(manifest);
+    }
+
+    // Marks `inputFile` as in progress, with the output `committedSize` bytes long when it started.
+    bool beginFile(const std::string& inputFile, uint64_t committedSize) {
+        std::string temporary = markerPath + ".tmp";
+        std::FILE* marker = std::fopen(temporary.c_str(), "wb");
+        if (!marker) return false;
+
+        std::ostringstream text;
+        text << std::quoted(inputFile) << " " << committedSize << "\n";
+        bool written = std::fputs(text.str().c_str(), marker) >= 0 && syncFile(marker);
+        std::fclose(marker);
+
+        std::error_code error;
+        if (written) std::filesystem::rename(temporary, markerPath, error);
+        return written && !error;
+    }
+
+    void endFile() {
+        std::error_code error;
+        std::filesystem::remove(markerPath, error);
+    }
+};
@@ -0,0 +1,219 @@
+﻿// Stats.h : Latency histograms per pipeline stage and throughput counters, with a periodic reporter.
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <iomanip>
+#include <mutex>
+#include <ostream>
+#include <thread>
+
+// HDR-style histogram of durations in nanoseconds: exact below 16 ns, then 16 buckets per power of
+// two, so every value is within about 6% of its bucket. Recording is a couple of relaxed atomic
+// adds, safe from any number of threads.
+class LatencyHistogram {
+private:
+    static constexpr int SubBucketBits = 4;
+    static constexpr int SubBuckets = 1 << SubBucketBits;
+    static constexpr int MaxBits = 44; // about 4.9 hours
+    static constexpr int BucketCount = SubBuckets + (MaxBits - SubBucketBits) * SubBuckets;
+
+    std::array<std::atomic<uint64_t>, BucketCount> buckets = {};
+    std::atomic<uint64_t> total = 0;
+    std::atomic<uint64_t> sum = 0;
+    std::atomic<uint64_t> maximum = 0;
+
+    static int bucketOf(uint64_t value) {
+        value = std::min<uint64_t>(value, (uint64_t(1) << MaxBits) - 1);
+        if (value < SubBuckets) return static_cast<int>(value);
+        int shift = std::bit_width(value) - 1 - SubBucketBits;
+        return SubBuckets + shift * SubBuckets + static_cast<int>((value >> shift) - SubBuckets);
+    }
+
+    // Middle of the range of values that land in `bucket`.
+    static uint64_t valueOf(int bucket) {
+        if (bucket < SubBuckets) return bucket;
+        int shift = (bucket - SubBuckets) / SubBuckets;
+        uint64_t low = uint64_t(SubBuckets + (bucket - SubBuckets) % SubBuckets) << shift;
+        return low + (uint64_t(1) << shift) / 2;
+    }
+
+public:
+    void record(uint64_t nanoseconds) {
+        buckets[bucketOf(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+        total.fetch_add(1, std::memory_order_relaxed);
+        sum.fetch_add(nanoseconds, std::memory_order_relaxed);
+        uint64_t seen = maximum.load(std::memory_order_relaxed);
+        while (nanoseconds > seen && !maximum.compare_exchange_weak(seen, nanoseconds, std::memory_order_relaxed)) {}
+    }
+
+    uint64_t count() const {
+        return total.load(std::memory_order_relaxed);
+    }
+
+    uint64_t totalNanoseconds() const {
+        return sum.load(std::memory_order_relaxed);
+    }
+
+    uint64_t max() const {
+        return maximum.load(std::memory_order_relaxed);
+    }
+
+    double mean() const {
+        uint64_t n = count();
+        return n ? static_cast<double>(totalNanoseconds()) / n : 0.0;
+    }
+
+    // Value at `fraction` (0..1) of the recorded values, to the bucket's resolution.
+    uint64_t percentile(double fraction) const {
+        uint64_t n = count();
+        if (n == 0) return 0;
+        uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(fraction * n + 0.5));
+        uint64_t seen = 0;
+        for (int b = 0; b < BucketCount; b++) {
+            seen += buckets[b].load(std::memory_order_relaxed);
+            if (seen >= rank) return std::min(valueOf(b), max());
+        }
+        return max();
+    }
+};
+
+// Where the time of a ply goes. Ply covers the whole ply in analyzeGame; Output and Sync are
+// spent on the writer thread, per game and per fsync.
+enum class Stage {
+    PositionCommand,
+    Fen,
+    Perft,
+    CacheProbe,
+    Search,
+    Ply,
+    Output,
+    Sync,
+    StageCount
+};
+
+class PipelineStats {
+private:
+    static constexpr int StageCount = static_cast<int>(Stage::StageCount);
+    static constexpr const char* stageNames[StageCount] = {
+        "position", "fen", "perft", "cache", "search", "ply", "output", "sync"
+    };
+
+    std::array<LatencyHistogram, StageCount> stages;
+    std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+
+    static void printDuration(std::ostream& out, double nanoseconds) {
+        if (nanoseconds < 1e3) out << std::setw(7) << nanoseconds << " ns";
+        else if (nanoseconds < 1e6) out << std::setw(7) << nanoseconds / 1e3 << " us";
+        else if (nanoseconds < 1e9) out << std::setw(7) << nanoseconds / 1e6 << " ms";
+        else out << std::setw(7) << nanoseconds / 1e9 << " s ";
+    }
+
+public:
+    std::atomic<uint64_t> games = 0;
+    std::atomic<uint64_t> plies = 0;
+    std::atomic<uint64_t> searches = 0;
+    std::atomic<uint64_t> cacheHits = 0;
+    std::atomic<uint64_t> sharedPlies = 0; // plies whose position another game of the same file also reached
+    std::atomic<uint64_t> skippedPlies = 0; // plies the ply filter left without a search
+    std::atomic<uint64_t> nodes = 0;       // as reported by the engines' last info line of each search
+    std::atomic<uint64_t> engineNps = 0;   // sum over searches, for the mean
+    std::atomic<uint64_t> depths = 0;      // sum over searches of the depth reached, for the mean
+    std::atomic<uint64_t> earlyStops = 0;  // searches an adaptive stop cut short
+
+    // Times the enclosing scope into one stage, unless `enabled` is false.
+    class Timer {
+    private:
+        LatencyHistogram* histogram;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    public:
+        Timer(PipelineStats& stats, Stage stage, bool enabled = true)
+            : histogram(enabled ? &stats.stage(stage) : nullptr) {
+        }
+
+        ~Timer() {
+            if (!histogram) return;
+            histogram->record(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+        }
+    };
+
+    LatencyHistogram& stage(Stage stage) {
+        return stages[static_cast<int>(stage)];
+    }
+
+    void report(std::ostream& out, const char* title) const {
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+        uint64_t searchCount = searches.load();
+        std::ios::fmtflags flags = out.flags();
+        out << std::fixed << std::setprecision(1)
+            << "--- " << title << " after " << seconds << " s ---\n"
+            << "games " << games << ", plies " << plies << " (" << plies / std::max(seconds, 1e-9) << "/s), "
+            << "searches " << searchCount << ", cache hits " << cacheHits << ", shared plies " << sharedPlies
+            << ", skipped plies " << skippedPlies << "\n"
+            << "engine nodes " << nodes << " (" << nodes / std::max(seconds, 1e-9) << "/s overall, "
+            << (searchCount ? engineNps / searchCount : 0) << " nps per search), mean depth "
+            << (searchCount ? double(depths) / searchCount : 0.0) << ", stopped early " << earlyStops << "\n"
+            << std::left << std::setw(10) << "stage" << std::right << std::setw(10) << "count"
+            << std::setw(11) << "mean" << std::setw(11) << "p50" << std::setw(11) << "p90"
+            << std::setw(11) << "p99" << std::setw(11) << "max" << std::setw(9) << "total s" << "\n";
+
+        for (int s = 0; s < StageCount; s++) {
+            const LatencyHistogram& h = stages[s];
+            if (h.count() == 0) continue;
+            out << std::left << std::setw(10) << stageNames[s] << std::right << std::setw(10) << h.count();
+            for (double value : { h.mean(), double(h.percentile(0.5)), double(h.percentile(0.9)), double(h.percentile(0.99)), double(h.max()) }) {
+                printDuration(out, value);
+            }
+            out << std::setw(9) << h.totalNanoseconds() / 1e9 << "\n";
+        }
+        out.flush();
+        out.flags(flags);
+    }
+};
+
+inline PipelineStats pipelineStats;
+
+// Prints pipelineStats to `out` every `intervalSeconds` (never if 0) and a final report when destroyed.
+class StatsReporter {
+private:
+    std::ostream& out;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping = false;
+    std::thread reporter;
+
+public:
+    StatsReporter(std::ostream& out, double intervalSeconds)
+        : out(out) {
+        if (intervalSeconds <= 0) return;
+        reporter = std::thread([this, intervalSeconds] {
+            std::unique_lock<std::mutex> lock(mutex);
+            auto interval = std::chrono::duration<double>(intervalSeconds);
+            while (!wake.wait_for(lock, interval, [this] { return stopping; })) {
+                pipelineStats.report(this->out, "stats");
+            }
+        });
+    }
+
+    StatsReporter(const StatsReporter&) = delete;
+    StatsReporter& operator=(const StatsReporter&) = delete;
+
+    ~StatsReporter() {
+        if (reporter.joinable()) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            wake.notify_one();
+            reporter.join();
+        }
+        pipelineStats.report(out, "final stats");
+    }
+};
@@ -0,0 +1,887 @@
+﻿// StockfishEngine.h : Runs a UCI engine as a child process and talks to it over pipes.
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/wait.h>
+#ifdef __linux__
+#include <sched.h>
+#include <sys/syscall.h>
+#endif
+#endif
+#include <cerrno>
+#include <cstring>
+
+#include "ChessPosition.h"
+#include "SystemTopology.h"
+
+// One request for StockfishEngine::beginSearch: the position command, then the position's FEN from the
+// engine's "d" if `engineFen`, the legal move count through "go perft 1" if `legalMoves` is -1, then the search.
+struct SearchRequest {
+    std::string command;
+    bool engineFen = false;
+    int legalMoves = -1;
+};
+
+// The fields of one "info" line of search output, as views into the line. Numbers the line doesn't have are -1.
+struct InfoLine {
+    int depth = -1;
+    int seldepth = -1;
+    bool hasScore = false;
+    bool mate = false;  // `score` is a distance to mate in moves rather than centipawns
+    bool bound = false; // a lowerbound or upperbound score, from a failed aspiration window
+    int score = 0;
+    int64_t nodes = -1;
+    int64_t nps = -1;
+    std::string_view pv; // the moves after "pv", space separated
+
+    // Splits `line` into its fields without allocating. Returns false, leaving `info` as it was, for anything
+    // but a search info line; "info string" lines are free text and don't count.
+    static bool parse(std::string_view line, InfoLine& info) {
+        const char* at = line.data();
+        const char* end = at + line.size();
+        auto skipSpaces = [&]() {
+            while (at < end && *at == ' ') at++;
+        };
+        // Keywords are matched in place, so only the tokens nobody reads are scanned a character at a time.
+        // The length is a template parameter so the comparison compiles to a few loads even if this isn't inlined.
+        auto take = [&]<size_t Size>(const char (&word)[Size]) {
+            constexpr size_t length = Size - 1;
+            if (static_cast<size_t>(end - at) < length || std::memcmp(at, word, length) != 0 ||
+                (at + length < end && at[length] != ' ')) return false;
+            at += length;
+            skipSpaces();
+            return true;
+        };
+        auto skipToken = [&]() {
+            while (at < end && *at != ' ') at++;
+            skipSpaces();
+        };
+        auto number = [&](auto& value) {
+            at = std::from_chars(at, end, value).ptr;
+            skipToken();
+        };
+
+        skipSpaces();
+        if (!take("info")) return false;
+        InfoLine parsed;
+        while (at < end) {
+            // Dispatch on the first letter; the values of fields nobody reads are skipped whole
+            switch (*at) {
+            case 'd':
+                if (take("depth")) { number(parsed.depth); continue; }
+                break;
+            case 's':
+                if (take("seldepth")) { number(parsed.seldepth); continue; }
+                if (take("score")) {
+                    parsed.mate = take("mate");
+                    parsed.hasScore = parsed.mate || take("cp");
+                    number(parsed.score);
+                    continue;
+                }
+                if (take("string")) return false;
+                break;
+            case 'n':
+                if (take("nodes")) { number(parsed.nodes); continue; }
+                if (take("nps")) { number(parsed.nps); continue; }
+                break;
+            case 'l': case 'u':
+                if (take("lowerbound") || take("upperbound")) { parsed.bound = true; continue; }
+                break;
+            case 'm': case 'h': case 't':
+                if (take("multipv") || take("hashfull") || take("tbhits") || take("time")) { skipToken(); continue; }
+                break;
+            case 'p':
+                if (take("pv")) {
+                    // The rest of the line
+                    while (end > at && end[-1] == ' ') end--;
+                    parsed.pv = std::string_view(at, end - at);
+                    at = end;
+                    continue;
+                }
+                break;
+            }
+            skipToken();
+        }
+        info = parsed;
+        return true;
+    }
+};
+
+// What one search produced, from evaluate() or a request. The search fields come from the last info line
+// that had them. `completed` is false if the engine stopped before answering.
+struct SearchResult {
+    static constexpr size_t MaxPvLength = 32;
+    static constexpr size_t MaxPvText = MaxPvLength * 6; // room for MaxPvLength moves of up to five characters and a space
+
+    double score = 0;      // centipawns, from the last "score cp"
+    double legalMoves = 0;
+    int mate = 0;          // moves to mate (negative when being mated) if the last score was a mate score, else 0
+    int seldepth = 0;
+    uint64_t nodes = 0;
+    uint64_t nps = 0;
+    Move bestMove = InvalidMove;
+    Move ponder = InvalidMove;
+    std::array<Move, MaxPvLength> pv = {}; // the first pvLength moves of the principal variation, once decoded
+    size_t pvLength = 0;
+    std::string fen;       // only with `engineFen`
+    uint64_t nanoseconds = 0; // from the request's first command to its answer
+    int depth = 0;         // searchDepth, or the last depth completed before an adaptive stop
+    bool stoppedEarly = false;
+    bool completed = false;
+
+    // The principal variation as the last info line wrote it. Every depth replaces the one before, so it
+    // is only decoded into `pv` once the search is over.
+    std::array<char, MaxPvText> pvText;
+    size_t pvTextLength = 0;
+
+    std::span<const Move> principalVariation() const {
+        return std::span<const Move>(pv.data(), pvLength);
+    }
+
+    // Folds one info line of the search into the results so far.
+    void addInfo(const InfoLine& info) {
+        if (info.hasScore && info.mate) {
+            mate = info.score;
+        }
+        else if (info.hasScore) {
+            score = info.score;
+            mate = 0;
+        }
+        if (info.seldepth >= 0) seldepth = info.seldepth;
+        if (info.nodes >= 0) nodes = static_cast<uint64_t>(info.nodes);
+        if (info.nps >= 0) nps = static_cast<uint64_t>(info.nps);
+
+        if (!info.pv.empty()) {
+            // Copied 16 bytes at a time, the last block overlapping the one before: a PV of a few dozen
+            // characters is too short for a call to memcpy to pay off
+            size_t length = std::min(info.pv.size(), MaxPvText);
+            const char* from = info.pv.data();
+            if (length >= 16) {
+                for (size_t i = 0; i + 16 < length; i += 16) std::memcpy(pvText.data() + i, from + i, 16);
+                std::memcpy(pvText.data() + length - 16, from + length - 16, 16);
+            }
+            else {
+                std::copy(from, from + length, pvText.data());
+            }
+            pvTextLength = length;
+        }
+    }
+
+    // Decodes the last principal variation into `pv`; called on "bestmove".
+    void decodePrincipalVariation() {
+        pvLength = 0;
+        const char* at = pvText.data();
+        const char* end = at + pvTextLength;
+        while (at < end && pvLength < MaxPvLength) {
+            // Moves are four characters, or five with a promotion
+            const char* space = at + 4 < end && at[4] != ' ' ? at + 5 : at + 4;
+            while (space < end && *space != ' ') space++;
+            pv[pvLength++] = parseUciMove(std::string_view(at, std::min(space, end) - at));
+            at = space + 1;
+        }
+    }
+};
+
+// Adaptive search, off by default: instead of always searching to searchDepth, the engine is sent "stop"
+// once the score of `stableDepths` consecutive depths has stayed within `windowCp` centipawns, or once the
+// search has used `maxNodes` nodes or `maxMilliseconds` (0 for no budget). Both are checked on every info
+// line, so a budget can be overrun by whatever the engine does before its next line.
+struct SearchLimits {
+    bool adaptive = false;
+    int windowCp = 15;
+    int stableDepths = 3;
+    uint64_t maxNodes = 0;
+    int maxMilliseconds = 0;
+};
+
+class StockfishEngine {
+private:
+#ifdef _WIN32
+    HANDLE hChildStdinWr = nullptr;
+    HANDLE hChildStdoutRd = nullptr;
+    PROCESS_INFORMATION piProcInfo;
+#else
+    pid_t childPid = -1;
+    int childStdin = -1;
+    int childStdout = -1;
+#endif
+    bool engineRunning = false;
+
+    // The running depth search, watched for an adaptive stop: the score of every depth completed so far.
+    SearchLimits limits;
+    std::vector<int> depthScores;
+    int completedDepth = 0;
+    bool stopSent = false;
+    std::chrono::steady_clock::time_point searchStart;
+
+    // Folds one line of search output into `result`, watching it for an adaptive stop. Returns true for
+    // the "bestmove" line that ends the search.
+    bool readSearchLine(const std::string& line, SearchResult& result) {
+        InfoLine info;
+        if (InfoLine::parse(line, info)) {
+            // Once stopped, the result stays at the depth that settled; an iteration cut short may still report
+            if (!stopSent) {
+                result.addInfo(info);
+                watchSearch(info);
+            }
+            return false;
+        }
+        if (line.rfind("bestmove", 0) != 0) return false;
+        result.decodePrincipalVariation();
+
+        // "bestmove e2e4 ponder e7e5"; "bestmove (none)" when there is no legal move
+        std::string_view rest = std::string_view(line).substr(8);
+        size_t start = rest.find_first_not_of(' ');
+        rest = start == std::string_view::npos ? std::string_view() : rest.substr(start);
+        size_t space = rest.find(' ');
+        result.bestMove = parseUciMove(rest.substr(0, space));
+        size_t ponder = rest.find(" ponder ");
+        if (ponder != std::string_view::npos) {
+            std::string_view move = rest.substr(ponder + 8);
+            result.ponder = parseUciMove(move.substr(0, move.find(' ')));
+        }
+        // After a stop the engine names the best move of whatever depth it was in; keep the one of the
+        // depth the result stayed at
+        if (stopSent && result.pvLength > 0) {
+            result.bestMove = result.pv[0];
+            result.ponder = result.pvLength > 1 ? result.pv[1] : InvalidMove;
+        }
+        return true;
+    }
+
+    void startDepthSearch() {
+        depthScores.clear();
+        completedDepth = 0;
+        stopSent = false;
+        searchStart = std::chrono::steady_clock::now();
+        sendCommand("go depth " + std::to_string(searchDepth));
+    }
+
+    // Adaptive mode: sends "stop" once `info` shows the running search has settled or spent its budget.
+    void watchSearch(const InfoLine& info) {
+        if (!limits.adaptive || stopSent) return;
+
+        // Lower and upper bounds are provisional results of an aspiration window, and currmove lines carry no score
+        if (info.hasScore && !info.bound && info.depth > 0) {
+            // Mates map far outside any centipawn score, so a score is only stable next to the same mate
+            constexpr int MateScore = 100000;
+            int score = !info.mate ? info.score : info.score > 0 ? MateScore - info.score : -MateScore - info.score;
+            if (info.depth > completedDepth) {
+                depthScores.push_back(score);
+                completedDepth = info.depth;
+            }
+            else if (info.depth == completedDepth && !depthScores.empty()) {
+                depthScores.back() = score;
+            }
+        }
+
+        bool settled = false;
+        size_t window = static_cast<size_t>(std::max(limits.stableDepths, 1));
+        if (depthScores.size() >= window) {
+            auto [low, high] = std::minmax_element(depthScores.end() - window, depthScores.end());
+            settled = *high - *low <= limits.windowCp;
+        }
+        bool overBudget = (limits.maxNodes > 0 && info.nodes >= 0 && static_cast<uint64_t>(info.nodes) >= limits.maxNodes) ||
+            (limits.maxMilliseconds > 0 && std::chrono::steady_clock::now() - searchStart >= std::chrono::milliseconds(limits.maxMilliseconds));
+        if (settled || overBudget) {
+            sendCommand("stop");
+            stopSent = true;
+        }
+    }
+
+    // The depth a finished search reached: searchDepth unless it was stopped early.
+    int reachedDepth() const {
+        return stopSent ? completedDepth : searchDepth;
+    }
+
+    // A "e2e4: 1" line of "go perft" output, one per legal move.
+    static bool isPerftMoveLine(std::string_view line) {
+        size_t colon = line.find(':');
+        return colon != std::string_view::npos && parseUciMove(line.substr(0, colon)) != InvalidMove;
+    }
+
+    // State of the request started by beginSearch, advanced by every line of output.
+    enum class RequestPhase {
+        Idle,
+        Fen,         // waiting for the "Fen: " line of "d"
+        Perft,       // counting "move: nodes" lines up to "Nodes searched", as countLegalMoves does
+        Search       // waiting for "bestmove"
+    };
+    RequestPhase phase = RequestPhase::Idle;
+    SearchResult pendingResult;
+    int requestLegalMoves = -1;
+    int perftMoves = 0;
+    std::chrono::steady_clock::time_point requestStart;
+
+    void startPerftOrSearch() {
+        if (requestLegalMoves < 0) {
+            sendCommand("go perft 1");
+            perftMoves = 0;
+            phase = RequestPhase::Perft;
+            return;
+        }
+        pendingResult.legalMoves = requestLegalMoves;
+        startDepthSearch();
+        phase = RequestPhase::Search;
+    }
+
+    // Engine output is read in large chunks and split into lines from this buffer.
+    std::vector<char> readBuffer = std::vector<char>(1 << 16);
+    size_t readPos = 0;
+    size_t readEnd = 0;
+    std::string partialLine; // readAvailable's line so far
+    std::string lineBuffer;  // evaluate's and finishSearch's current line
+
+    // Blocks until the engine has written more output and appends it to readBuffer.
+    // Returns false once the engine has closed its end of the pipe.
+    bool fillBuffer() {
+        readPos = readEnd = 0;
+#ifdef _WIN32
+        DWORD read = 0;
+        if (!ReadFile(hChildStdoutRd, readBuffer.data(), static_cast<DWORD>(readBuffer.size()), &read, nullptr) || read == 0) {
+            return false;
+        }
+        readEnd = read;
+        return true;
+#else
+        while (true) {
+            pollfd pfd = { childStdout, POLLIN, 0 };
+            if (poll(&pfd, 1, -1) < 0) {
+                if (errno == EINTR) continue;
+                return false;
+            }
+
+            ssize_t n = read(childStdout, readBuffer.data(), readBuffer.size());
+            if (n > 0) {
+                readEnd = static_cast<size_t>(n);
+                return true;
+            }
+            if (n == 0) return false;
+            if (errno != EINTR && errno != EAGAIN) return false;
+        }
+#endif
+    }
+
+public:
+#ifdef _WIN32
+    static constexpr const char* defaultPath = "stockfish.exe";
+#else
+    static constexpr const char* defaultPath = "stockfish";
+#endif
+
+    static constexpr int searchDepth = 10;
+
+    ~StockfishEngine() {
+        if (engineRunning) {
+            sendCommand("quit");
+        }
+#ifdef _WIN32
+        if (engineRunning) {
+            if (piProcInfo.hProcess) {
+                WaitForSingleObject(piProcInfo.hProcess, 1000);
+                CloseHandle(piProcInfo.hProcess);
+                CloseHandle(piProcInfo.hThread);
+            }
+            if (hChildStdinWr) CloseHandle(hChildStdinWr);
+            if (hChildStdoutRd) CloseHandle(hChildStdoutRd);
+        }
+#else
+        if (childStdin >= 0) close(childStdin);
+        if (childStdout >= 0) close(childStdout);
+        if (childPid > 0) {
+            // Give the engine a second to exit on "quit" before killing it.
+            for (int i = 0; i < 100 && waitpid(childPid, nullptr, WNOHANG) == 0; i++) {
+                usleep(10000);
+            }
+            if (kill(childPid, 0) == 0) {
+                kill(childPid, SIGKILL);
+                waitpid(childPid, nullptr, 0);
+            }
+        }
+#endif
+    }
+
+    bool init(const std::string& path = defaultPath, int threads = 16, int hashMb = 16384) {
+        EngineResources resources;
+        resources.threads = threads;
+        resources.hashMb = hashMb;
+        return init(path, resources);
+    }
+
+    // Starts the engine with the Threads and Hash of `resources`, restricted to its CPUs and, where
+    // the platform allows, with its memory preferred on its NUMA node.
+    bool init(const std::string& path, const EngineResources& resources) {
+#ifdef _WIN32
+        SECURITY_ATTRIBUTES saAttr = { sizeof(SECURITY_ATTRIBUTES), nullptr, TRUE };
+        HANDLE hChildStdinRd, hChildStdoutWr;
+
+        if (!CreatePipe(&hChildStdoutRd, &hChildStdoutWr, &saAttr, 0) ||
+            !SetHandleInformation(hChildStdoutRd, HANDLE_FLAG_INHERIT, 0) ||
+            !CreatePipe(&hChildStdinRd, &hChildStdinWr, &saAttr, 0) ||
+            !SetHandleInformation(hChildStdinWr, HANDLE_FLAG_INHERIT, 0)) {
+            return false;
+        }
+
+        STARTUPINFO si = { sizeof(STARTUPINFO) };
+        si.hStdError = si.hStdOutput = hChildStdoutWr;
+        si.hStdInput = hChildStdinRd;
+        si.dwFlags = STARTF_USESTDHANDLES;
+
+        ZeroMemory(&piProcInfo, sizeof(PROCESS_INFORMATION));
+        std::string cmd = path;
+
+        // Affinity masks cover one processor group; CPUs of other groups are left unpinned.
+        // Windows places memory on the node of the thread that touches it first, so the hash
+        // follows the pinned threads.
+        DWORD_PTR affinityMask = 0;
+        for (int cpu : resources.cpus) {
+            if (cpu < 64) affinityMask |= DWORD_PTR(1) << cpu;
+        }
+
+        if (!CreateProcess(nullptr, const_cast<char*>(cmd.c_str()), nullptr, nullptr,
+            TRUE, affinityMask ? CREATE_SUSPENDED : 0, nullptr, nullptr, &si, &piProcInfo)) {
+            CloseHandle(hChildStdoutRd); CloseHandle(hChildStdoutWr);
+            CloseHandle(hChildStdinRd); CloseHandle(hChildStdinWr);
+            return false;
+        }
+        if (affinityMask) {
+            SetProcessAffinityMask(piProcInfo.hProcess, affinityMask);
+            ResumeThread(piProcInfo.hThread);
+        }
+
+        CloseHandle(hChildStdoutWr); CloseHandle(hChildStdinRd);
+#else
+        // A dead engine must surface as a failed write, not kill the analyzer.
+        signal(SIGPIPE, SIG_IGN);
+
+        int toChild[2], fromChild[2], execStatus[2];
+        if (pipe2(toChild, O_CLOEXEC) != 0) return false;
+        if (pipe2(fromChild, O_CLOEXEC) != 0) {
+            close(toChild[0]); close(toChild[1]);
+            return false;
+        }
+        if (pipe2(execStatus, O_CLOEXEC) != 0) {
+            close(toChild[0]); close(toChild[1]);
+            close(fromChild[0]); close(fromChild[1]);
+            return false;
+        }
+
+#ifdef __linux__
+        // Built before the fork; the child only makes the system calls. Both the affinity and the
+        // memory policy survive exec, so the engine's threads and hash stay on its node.
+        cpu_set_t cpuSet;
+        CPU_ZERO(&cpuSet);
+        for (int cpu : resources.cpus) {
+            if (cpu >= 0 && cpu < CPU_SETSIZE) CPU_SET(cpu, &cpuSet);
+        }
+        constexpr int PreferredNode = 1; // MPOL_PREFERRED: fall back to other nodes when this one is full
+        unsigned long nodeMask[16] = {};
+        bool preferNode = resources.numaNode >= 0 && resources.numaNode < static_cast<int>(sizeof(nodeMask) * 8);
+        if (preferNode) nodeMask[resources.numaNode / 64] |= 1UL << (resources.numaNode % 64);
+#endif
+
+        childPid = fork();
+        if (childPid == 0) {
+            dup2(toChild[0], STDIN_FILENO);
+            dup2(fromChild[1], STDOUT_FILENO);
+            dup2(fromChild[1], STDERR_FILENO);
+#ifdef __linux__
+            if (!resources.cpus.empty()) sched_setaffinity(0, sizeof(cpuSet), &cpuSet);
+            if (preferNode) syscall(SYS_set_mempolicy, PreferredNode, nodeMask, sizeof(nodeMask) * 8 + 1);
+#endif
+            execlp(path.c_str(), path.c_str(), static_cast<char*>(nullptr));
+
+            // Only reached if exec failed; report errno through the status pipe.
+            int error = errno;
+            ssize_t ignored = write(execStatus[1], &error, sizeof(error));
+            (void)ignored;
+            _exit(127);
+        }
+
+        close(toChild[0]);
+        close(fromChild[1]);
+        close(execStatus[1]);
+
+        // The status pipe is close-on-exec, so it reads EOF as soon as exec succeeds.
+        int execError = 0;
+        ssize_t statusRead;
+        do {
+            statusRead = read(execStatus[0], &execError, sizeof(execError));
+        } while (statusRead < 0 && errno == EINTR);
+        close(execStatus[0]);
+
+        if (childPid < 0 || statusRead > 0) {
+            close(toChild[1]);
+            close(fromChild[0]);
+            if (childPid > 0) waitpid(childPid, nullptr, 0);
+            childPid = -1;
+            return false;
+        }
+
+        childStdin = toChild[1];
+        childStdout = fromChild[0];
+#endif
+        engineRunning = true;
+
+        sendCommand("uci");
+        std::string line;
+        while ((line = readLine()) != "uciok" && !line.empty()) {}
+
+        sendCommand("setoption name Threads value " + std::to_string(resources.threads));
+        sendCommand("setoption name Hash value " + std::to_string(resources.hashMb));
+
+        sendCommand("isready");
+        while ((line = readLine()) != "readyok" && !line.empty()) {}
+
+        return engineRunning;
+    }
+
+    bool isRunning() const {
+        return engineRunning;
+    }
+
+    void sendCommand(const std::string& cmd) {
+        if (!engineRunning) return;
+        std::string command = cmd + "\n";
+#ifdef _WIN32
+        DWORD written;
+        WriteFile(hChildStdinWr, command.c_str(), command.length(), &written, nullptr);
+#else
+        size_t offset = 0;
+        while (offset < command.length()) {
+            ssize_t n = write(childStdin, command.data() + offset, command.length() - offset);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                engineRunning = false;
+                return;
+            }
+            offset += static_cast<size_t>(n);
+        }
+#endif
+    }
+
+    // Returns the next line of engine output without the line terminator.
+    // Returns an empty line and stops the engine if its output pipe was closed.
+    std::string readLine() {
+        std::string line;
+        readLine(line);
+        return line;
+    }
+
+    // The same into `line`, whose buffer is reused.
+    void readLine(std::string& line) {
+        line.clear();
+
+        while (true) {
+            if (readPos == readEnd && !fillBuffer()) {
+                engineRunning = false;
+                return;
+            }
+
+            const char* start = readBuffer.data() + readPos;
+            const char* end = readBuffer.data() + readEnd;
+            const char* newline = static_cast<const char*>(memchr(start, '\n', end - start));
+
+            if (newline == nullptr) {
+                line.append(start, end);
+                readPos = readEnd;
+                continue;
+            }
+
+            line.append(start, newline);
+            readPos = static_cast<size_t>(newline - readBuffer.data()) + 1;
+            if (!line.empty() && line.back() == '\r') {
+                line.pop_back();
+            }
+            return;
+        }
+    }
+
+
+    // Counts the legal moves through the engine. ChessPosition::countLegalMoves gives the same
+    // number without the round trip; this is only the fallback when our board can't be trusted.
+    // Reads up to the "Nodes searched" line, so nothing of the listing is left for the next command.
+    int countLegalMoves() {
+        sendCommand("go perft 1");
+
+        /*
+            In the current version of stockfish, excuting the command {go perft 1}, outputs all the legal moves in the position.
+            The following chunk of code is utilizing the formate of the stockfish output to count the legal moves
+
+            e.g:
+
+            go perft 1
+            info string Available processors: 0-7
+            info string Using 1 thread
+            info string NNUE evaluation using nn-1c0000000000.nnue (133MiB, (22528, 3072, 15, 32, 1))
+            info string NNUE evaluation using nn-37f18f62d772.nnue (6MiB, (22528, 128, 15, 32, 1))
+            a2a3: 1
+            b2b3: 1
+            d2d3: 1
+            ...
+
+            Nodes searched: 30
+
+
+            Only the "move: nodes" lines count; the header lines before them can contain colons too.
+        */
+
+        int count = 0;
+        while (true) {
+            readLine(lineBuffer);
+            if (!engineRunning || lineBuffer.rfind("Nodes searched", 0) == 0) break;
+            if (isPerftMoveLine(lineBuffer)) count++;
+        }
+        return count;
+    }
+
+    // Searches the current position to searchDepth (or until an adaptive stop) and returns the score, mate
+    // distance, best move, principal variation and search statistics, with the legal move count.
+    // `legalMoves` is the native count from ChessPosition; pass -1 to get it from "go perft 1" instead.
+    SearchResult evaluate([[maybe_unused]] bool isWhiteToMove = true, int legalMoves = -1) {
+        SearchResult result;
+        result.legalMoves = legalMoves >= 0 ? legalMoves : countLegalMoves();
+
+        // NOTE: The vision was to go to depth 20-22 ( which are commonly used in game reviews ) but for the lack of the power of calculation and for the main purpose of the project ( to be shipped fast ), unfourtunately, I had to limit the depth to 10. 
+        startDepthSearch();
+        /*
+        In this section, I'm using a similar trick to the one I used in the previous section.
+
+        Stockfish 17.1 by the Stockfish developers (see AUTHORS file)
+        position set 1N6/p2k1pp1/7p/2p5/3b1P2/8/P5PP/2R2K2 b - - 0 30
+        go depth 25
+        info string Available processors: 0-11
+        info string Using 1 thread
+        info string NNUE evaluation using nn-1c0000000000.nnue (133MiB, (22528, 3072, 15, 32, 1))
+        info string NNUE evaluation using nn-37f18f62d772.nnue (6MiB, (22528, 128, 15, 32, 1))
+        info depth 1 seldepth 2 multipv 1 score cp 17 nodes 20 nps 6666 hashfull 0 tbhits 0 time 3 pv e2e4
+        info depth 2 seldepth 3 multipv 1 score cp 34 nodes 45 nps 11250 hashfull 0 tbhits 0 time 4 pv e2e4
+        info depth 3 seldepth 4 multipv 1 score cp 42 nodes 72 nps 18000 hashfull 0 tbhits 0 time 4 pv e2e4
+        info depth 4 seldepth 7 multipv 1 score cp 39 nodes 512 nps 102400 hashfull 0 tbhits 0 time 5 pv g1f3 d7d5 d2d4
+        info depth 5 seldepth 7 multipv 1 score cp 58 nodes 609 nps 121800 hashfull 0 tbhits 0 time 5 pv e2e4
+        info depth 6 seldepth 8 multipv 1 score cp 57 nodes 752 nps 125333 hashfull 0 tbhits 0 time 6 pv e2e4 d7d5 e4d5 d8d5 g1f3
+        info depth 7 seldepth 10 multipv 1 score cp 46 nodes 2019 nps 252375 hashfull 0 tbhits 0 time 8 pv e2e4 c7c5 d2d4 c5d4 g1f3
+        info depth 8 seldepth 13 multipv 1 score cp 47 nodes 3436 nps 343600 hashfull 1 tbhits 0 time 10 pv e2e4 c7c5 b1c3 b8c6 g1f3 g8f6
+        info depth 9 seldepth 13 multipv 1 score cp 94 nodes 4748 nps 395666 hashfull 1 tbhits 0 time 12 pv e2e4 c7c5 g1f3 b8c6 b1c3 b7b6
+        info depth 10 seldepth 17 multipv 1 score cp 40 nodes 8620 nps 507058 hashfull 2 tbhits 0 time 17 pv e2e4 c7c5 g1f3 b8c6 b1c3 g8f6 d2d4 c5d4 f3d4 e7e6 d4c6 b7c6
+        info depth 11 seldepth 17 multipv 1 score cp 41 nodes 15172 nps 561925 hashfull 4 tbhits 0 time 27 pv e2e4 c7c5 g1f3 e7e6 b1c3 b8c6 d2d4 c5d4 f3d4 g8f6 a2a3 f8e7 d4c6 d7c6
+        info depth 12 seldepth 19 multipv 1 score cp 33 nodes 34187 nps 633092 hashfull 12 tbhits 0 time 54 pv e2e4 e7e5 g1f3 b8c6 d2d4 e5d4 f3d4 g8f6 d4c6 d7c6 d1d8 e8d8 f1d3 f8b4 c2c3
+        info depth 13 seldepth 17 multipv 1 score cp 35 nodes 37544 nps 625733 hashfull 12 tbhits 0 time 60 pv e2e4 e7e5 b1c3 b8c6 g1f3 f8b4 d2d4 e5d4 f3d4 g8f6 d4c6 d7c6 d1d8 e8d8
+        info depth 14 seldepth 19 multipv 1 score cp 40 nodes 50495 nps 631187 hashfull 17 tbhits 0 time 80 pv e2e4 e7e5 g1f3 g8f6 b1c3 d7d6 d2d4 e5d4 d1d4 f8e7
+        info depth 15 seldepth 18 multipv 1 score cp 39 nodes 64450 nps 625728 hashfull 21 tbhits 0 time 103 pv e2e4 e7e5 g1f3 g8f6 d2d4 f6e4 d4e5 d7d5 f1d3 b8c6 e1g1 c8e6 b1c3 e4c3 b2c3
+        info depth 16 seldepth 20 multipv 1 score cp 37 nodes 80751 nps 616419 hashfull 27 tbhits 0 time 131 pv e2e4 e7e5 g1f3 g8f6 d2d4 f6e4 f3e5 d7d5 b1d2 b8d7 d2e4 d5e4 d1h5 g7g6 h5e2 d7e5 e2e4 f8g7 d4e5
+        info depth 17 seldepth 23 multipv 1 score cp 37 nodes 100673 nps 621438 hashfull 34 tbhits 0 time 162 pv e2e4 e7e5 g1f3 g8f6 b1c3 d7d6 d2d4 e5d4 f3d4 f8e7 f1b5 c7c6 b5d3 e8g8 e1g1 c6c5 d4f3 b8c6
+        info depth 18 seldepth 28 multipv 1 score cp 30 nodes 242639 nps 636847 hashfull 94 tbhits 0 time 381 pv e2e4 e7e5 g1f3 b8c6 f1e2 d7d5 e4d5 d8d5 d2d3 c8e6 e1g1 f8d6 f1e1 h7h6
+        info depth 19 seldepth 27 multipv 1 score cp 40 nodes 294310 nps 642598 hashfull 109 tbhits 0 time 458 pv e2e4 e7e5 g1f3 g8f6 f3e5 d7d6 e5f3 f6e4 d2d4 d6d5 f1d3 f8b4 c2c3 b4d6 e1g1 e8g8 c3c4 c7c6 d1c2 b8a6 d3e4 d5e4 c2e4 f8e8
+        info depth 20 seldepth 33 multipv 1 score cp 40 nodes 356864 nps 652402 hashfull 127 tbhits 0 time 547 pv e2e4 e7e5 g1f3 b8c6 f1b5 a7a6 b5a4 g8f6 e1g1 f6e4 d2d4 f8e7 f1e1 b7b5 e1e4 b5a4 d4e5
+        info depth 21 seldepth 35 multipv 1 score cp 40 nodes 693162 nps 638858 hashfull 257 tbhits 0 time 1085 pv e2e4 e7e5 g1f3 b8c6 d2d4 e5d4 f3d4 g8f6 d4c6 d7c6 d1d8 e8d8 b1c3 d8e8 c1d2 a7a5 a2a3 f8d6 f2f4
+        info depth 22 seldepth 29 multipv 1 score cp 38 nodes 753875 nps 638336 hashfull 279 tbhits 0 time 1181 pv e2e4 e7e5 g1f3 b8c6 f1b5 a7a6 b5a4 g8f6 e1g1 f8e7 f1e1 b7b5 a4b3 e8g8 c2c3 c6a5 b3c2 d7d5 d2d4 e5d4 e4d5 f8e8 c3d4 c8b7 b1c3 f6d5
+        info depth 23 seldepth 31 multipv 1 score cp 34 nodes 901681 nps 644057 hashfull 329 tbhits 0 time 1400 pv e2e4 e7e5 g1f3 b8c6 f1b5 a7a6 b5a4 g8f6 e1g1 f8e7 d2d3 b7b5 a4b3 d7d6 a2a4 c6a5 a4b5 a5b3 c2b3 e8g8 h2h3 c8b7
+        info depth 24 seldepth 32 multipv 1 score cp 36 nodes 1179519 nps 649514 hashfull 426 tbhits 0 time 1816 pv e2e4 e7e5 g1f3 b8c6 f1b5 a7a6 b5a4 g8f6 e1g1 f6e4 d2d4 b7b5 a4b3 d7d5 d4e5 c8e6 b1d2 e4c5 c2c3 c5b3 d2b3 f8e7 f3d4 c6d4 b3d4
+        info depth 25 seldepth 35 multipv 1 score cp 24 nodes 2042808 nps 635596 hashfull 668 tbhits 0 time 3214 pv e2e4 e7e5 g1f3 b8c6 f1b5 g8f6 e1g1 f6e4 f1e1 e4d6 f3e5 f8e7 b5f1 d6f5 e5f3 c6d4 c2c3 d4f3 d1f3 d7d6 d2d4 e8g8 f1d3 f5h4 f3e2 f8e8 g2g3 h4g6 h2h4 c7c6 h4h5 g6f8 h5h6 g7g6
+        bestmove e2e4 ponder e7e5 <<- Look at the line above it!
+        */
+
+        // --- Parse Stockfish's output ---
+        // Read lines until we see "bestmove", which signals the end of the search.
+        while (true) {
+            readLine(lineBuffer);
+
+            // Stop when "bestmove" appears — that means Stockfish has finished.
+            if (readSearchLine(lineBuffer, result)) {
+                result.completed = true;
+                break;
+            }
+
+            if (!engineRunning) break;
+        }
+        result.depth = reachedDepth();
+        result.stoppedEarly = stopSent;
+        result.nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - searchStart).count();
+
+        // --- Print the final evaluation ---
+        /*
+
+
+        NOTE: might be used later - this code divides the evaluation score by 100 to convert centipawns to pawns ( the metric used by chess.com ) 
+        if (mateFound) {
+            result.score = 25;
+        }
+        else {
+            // Convert centipawns to a more human-readable pawn value.
+            double pawnValue = evalScore / 100.0;
+            if (pawnValue > 25) {
+                pawnValue = 25;
+            }
+            
+            // return pawnValue;
+            result.score = pawnValue;
+        }
+        */
+
+        return result;
+    }
+
+    // Applies to every depth search started from now on; see SearchLimits.
+    void setSearchLimits(const SearchLimits& searchLimits) {
+        limits = searchLimits;
+        depthScores.reserve(searchDepth + 1);
+    }
+
+    // Sends `search`'s commands without waiting for the engine. Its output then goes to onOutputLine
+    // line by line until the request completes; see EngineEventLoop.
+    void beginSearch(const SearchRequest& search) {
+        pendingResult = SearchResult();
+        requestStart = std::chrono::steady_clock::now();
+        requestLegalMoves = search.legalMoves;
+        sendCommand(search.command);
+        if (search.engineFen) {
+            sendCommand("d");
+            phase = RequestPhase::Fen;
+        }
+        else {
+            startPerftOrSearch();
+        }
+    }
+
+    // Feeds one line of engine output to the request begun last, sending the next command when a step
+    // finishes. Returns true when the request is complete, with `result` filled in. Lines that arrive
+    // with no request running are ignored.
+    bool onOutputLine(const std::string& line, SearchResult& result) {
+        switch (phase) {
+        case RequestPhase::Idle:
+            return false;
+        case RequestPhase::Fen:
+            if (line.find("Fen: ") == std::string::npos) return false;
+            pendingResult.fen = line.substr(line.find("Fen: ") + 5);
+            startPerftOrSearch();
+            return false;
+        case RequestPhase::Perft:
+            if (line.rfind("Nodes searched", 0) != 0) {
+                if (isPerftMoveLine(line)) perftMoves++;
+                return false;
+            }
+            pendingResult.legalMoves = perftMoves;
+            startDepthSearch();
+            phase = RequestPhase::Search;
+            return false;
+        case RequestPhase::Search:
+            if (!readSearchLine(line, pendingResult)) return false;
+            pendingResult.completed = true;
+            pendingResult.depth = reachedDepth();
+            pendingResult.stoppedEarly = stopSent;
+            pendingResult.nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - requestStart).count();
+            phase = RequestPhase::Idle;
+            result = std::move(pendingResult);
+            return true;
+        }
+        return false;
+    }
+
+    // Waits for the request begun last, reading the output on this thread. Returns false, with what was
+    // parsed so far, if the engine stopped before answering.
+    bool finishSearch(SearchResult& result) {
+        while (true) {
+            readLine(lineBuffer);
+            if (!engineRunning) {
+                abandonSearch(result);
+                return false;
+            }
+            if (onOutputLine(lineBuffer, result)) return true;
+        }
+    }
+
+    // Ends the request begun last without an answer, when the engine has stopped: `result` gets what was
+    // parsed so far, with `completed` false.
+    void abandonSearch(SearchResult& result) {
+        phase = RequestPhase::Idle;
+        result = std::move(pendingResult);
+        result.completed = false;
+    }
+
+#ifndef _WIN32
+    // The engine's output pipe, for the event loop to wait on.
+    int outputHandle() const {
+        return childStdout;
+    }
+
+    // Switches the output pipe between the blocking reads of readLine (the default) and the non-blocking
+    // ones of readAvailable. EngineEventLoop switches it for as long as it drives the engine.
+    void setNonBlockingOutput(bool enabled) {
+        if (childStdout < 0) return;
+        int flags = fcntl(childStdout, F_GETFL);
+        if (flags < 0) return;
+        int wanted = enabled ? flags | O_NONBLOCK : flags & ~O_NONBLOCK;
+        if (wanted != flags) fcntl(childStdout, F_SETFL, wanted);
+    }
+
+    // Passes every complete line of output the engine has written so far to onLine, without blocking; the
+    // pipe must be non-blocking (see setNonBlockingOutput). Returns false once the engine has closed its
+    // end of the pipe.
+    template <typename OnLine>
+    bool readAvailable(OnLine&& onLine) {
+        while (true) {
+            if (readPos == readEnd) {
+                ssize_t n = read(childStdout, readBuffer.data(), readBuffer.size());
+                if (n < 0 && errno == EINTR) continue;
+                if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return true;
+                if (n <= 0) {
+                    engineRunning = false;
+                    return false;
+                }
+                readPos = 0;
+                readEnd = static_cast<size_t>(n);
+            }
+
+            const char* start = readBuffer.data() + readPos;
+            const char* end = readBuffer.data() + readEnd;
+            const char* newline = static_cast<const char*>(memchr(start, '\n', end - start));
+            if (newline == nullptr) {
+                partialLine.append(start, end);
+                readPos = readEnd;
+                continue;
+            }
+
+            partialLine.append(start, newline);
+            readPos = static_cast<size_t>(newline - readBuffer.data()) + 1;
+            if (!partialLine.empty() && partialLine.back() == '\r') {
+                partialLine.pop_back();
+            }
+            onLine(partialLine);
+            partialLine.clear();
+        }
+    }
+#endif
+
+    std::string getFenPosition() {
+        sendCommand("d");
+        std::string fenLine;
+        for (;;) {
+            std::string line = readLine();
+            if (line.find("Fen: ") != std::string::npos) {
+                fenLine = line.substr(line.find("Fen: ") + 5); // extract after "Fen: "
+                // std::cout << fenLine << std::endl;
+                return fenLine;
+            }
+            if (!engineRunning) break;
+        }
+
+        return "";
+    }
+};
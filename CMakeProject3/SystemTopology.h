@@ -0,0 +1,263 @@
+﻿// SystemTopology.h : Detects the CPUs, NUMA nodes and memory available to the analyzer, and splits
+// them between engine instances.
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#ifdef __linux__
+#include <sched.h>
+#endif
+#endif
+
+struct NumaNode {
+    int id = 0;
+    std::vector<int> cpus; // logical CPUs of the node this process may run on
+    uint64_t memoryMb = 0; // available memory attributed to the node
+};
+
+// What one engine instance gets: its Threads and Hash options, and where it runs. `cpus` empty means
+// no pinning; `numaNode` -1 means no preferred node for its memory.
+struct EngineResources {
+    int threads = 1;
+    int hashMb = 16;
+    int numaNode = -1;
+    std::vector<int> cpus;
+};
+
+class SystemTopology {
+private:
+    std::vector<NumaNode> numaNodes;
+    uint64_t availableMb = 0;
+
+#ifdef __linux__
+    // Parses a kernel CPU or node list such as "0-3,8-11".
+    static std::vector<int> parseCpuList(const std::string& list) {
+        std::vector<int> cpus;
+        std::stringstream ss(list);
+        std::string range;
+        while (std::getline(ss, range, ',')) {
+            int first = 0, last = 0;
+            char dash = 0;
+            std::stringstream rs(range);
+            if (!(rs >> first)) continue;
+            last = (rs >> dash >> last) ? last : first;
+            for (int cpu = first; cpu <= last; cpu++) cpus.push_back(cpu);
+        }
+        return cpus;
+    }
+
+    // The number of kB on the line of `file` that contains `key`, or 0.
+    static uint64_t meminfoKb(const std::string& file, const std::string& key) {
+        std::ifstream in(file);
+        std::string line;
+        while (std::getline(in, line)) {
+            size_t at = line.find(key);
+            if (at == std::string::npos) continue;
+            return std::stoull(line.substr(at + key.size()));
+        }
+        return 0;
+    }
+#endif
+
+public:
+    static SystemTopology detect() {
+        SystemTopology topology;
+#ifdef _WIN32
+        MEMORYSTATUSEX status = { sizeof(MEMORYSTATUSEX) };
+        if (GlobalMemoryStatusEx(&status)) topology.availableMb = status.ullAvailPhys >> 20;
+
+        DWORD_PTR processMask = 0, systemMask = 0;
+        GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask);
+
+        ULONG highestNode = 0;
+        GetNumaHighestNodeNumber(&highestNode);
+        for (USHORT node = 0; node <= highestNode; node++) {
+            GROUP_AFFINITY affinity = {};
+            if (!GetNumaNodeProcessorMaskEx(node, &affinity)) continue;
+            NumaNode numaNode;
+            numaNode.id = node;
+            for (int bit = 0; bit < 64; bit++) {
+                KAFFINITY cpuBit = KAFFINITY(1) << bit;
+                if (!(affinity.Mask & cpuBit)) continue;
+                // The process mask only covers its own group
+                if (affinity.Group == 0 && processMask && !(processMask & cpuBit)) continue;
+                numaNode.cpus.push_back(affinity.Group * 64 + bit);
+            }
+            ULONGLONG nodeBytes = 0;
+            if (GetNumaAvailableMemoryNodeEx(node, &nodeBytes)) numaNode.memoryMb = nodeBytes >> 20;
+            if (!numaNode.cpus.empty()) topology.numaNodes.push_back(std::move(numaNode));
+        }
+#else
+#ifdef __linux__
+        // The CPUs this process may run on, which a container or taskset can restrict
+        std::vector<int> allowed;
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+            for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+                if (CPU_ISSET(cpu, &set)) allowed.push_back(cpu);
+            }
+        }
+
+        topology.availableMb = meminfoKb("/proc/meminfo", "MemAvailable:") >> 10;
+
+        // Available memory is split between the nodes in proportion to their size
+        std::vector<uint64_t> nodeTotals;
+        uint64_t totalKb = 0;
+        std::ifstream online("/sys/devices/system/node/online");
+        std::string onlineList;
+        std::getline(online, onlineList);
+        for (int node : parseCpuList(onlineList)) {
+            std::string dir = "/sys/devices/system/node/node" + std::to_string(node);
+            std::ifstream cpulist(dir + "/cpulist");
+            std::string list;
+            std::getline(cpulist, list);
+
+            NumaNode numaNode;
+            numaNode.id = node;
+            for (int cpu : parseCpuList(list)) {
+                if (std::find(allowed.begin(), allowed.end(), cpu) != allowed.end()) numaNode.cpus.push_back(cpu);
+            }
+            if (numaNode.cpus.empty()) continue;
+            uint64_t nodeKb = meminfoKb(dir + "/meminfo", "MemTotal:");
+            nodeTotals.push_back(nodeKb);
+            totalKb += nodeKb;
+            topology.numaNodes.push_back(std::move(numaNode));
+        }
+        for (size_t i = 0; i < topology.numaNodes.size(); i++) {
+            topology.numaNodes[i].memoryMb = totalKb ? topology.availableMb * nodeTotals[i] / totalKb :
+                topology.availableMb / topology.numaNodes.size();
+        }
+
+        if (topology.numaNodes.empty() && !allowed.empty()) {
+            NumaNode numaNode;
+            numaNode.id = -1;
+            numaNode.cpus = allowed;
+            numaNode.memoryMb = topology.availableMb;
+            topology.numaNodes.push_back(std::move(numaNode));
+        }
+#else
+        long pages = sysconf(_SC_PHYS_PAGES);
+        long pageSize = sysconf(_SC_PAGE_SIZE);
+        if (pages > 0 && pageSize > 0) topology.availableMb = (uint64_t(pages) * uint64_t(pageSize)) >> 20;
+#endif
+#endif
+        // Fallback without topology information: one node with every CPU, no pinning possible
+        if (topology.numaNodes.empty()) {
+            NumaNode numaNode;
+            numaNode.id = -1;
+            numaNode.memoryMb = topology.availableMb;
+            topology.numaNodes.push_back(std::move(numaNode));
+        }
+        return topology;
+    }
+
+    const std::vector<NumaNode>& nodes() const {
+        return numaNodes;
+    }
+
+    size_t cpuCount() const {
+        size_t count = 0;
+        for (const NumaNode& node : numaNodes) count += node.cpus.size();
+        if (count == 0) count = std::max(1u, std::thread::hardware_concurrency());
+        return count;
+    }
+
+    uint64_t memoryMb() const {
+        return availableMb;
+    }
+
+    // Splits the machine between `engineCount` engines. `totalThreads` and `totalHashMb` are the budgets to
+    // split, 0 for every available CPU and half of the available memory. Engines are spread over the NUMA
+    // nodes, each pinned to its own slice of its node's CPUs with its hash preferred on that node; with
+    // fewer engines than nodes an engine spans several nodes and has no preferred node. An engine gets
+    // threads for the CPUs it runs on, scaled to `totalThreads`, so a node with more engines than another
+    // gives each of them fewer threads instead of being oversubscribed. `pin` false only splits the budgets.
+    std::vector<EngineResources> partition(size_t engineCount, int totalThreads = 0, int totalHashMb = 0, bool pin = true) const {
+        if (engineCount == 0) engineCount = 1;
+        size_t machineCpus = cpuCount();
+        if (totalThreads <= 0) totalThreads = static_cast<int>(machineCpus);
+        auto threadsFor = [&](size_t cpus) {
+            return std::max(1, static_cast<int>(cpus * static_cast<size_t>(totalThreads) / machineCpus));
+        };
+        bool autoHash = totalHashMb <= 0;
+        int hashPerEngine = std::max(16, totalHashMb / static_cast<int>(engineCount));
+
+        // The nodes each engine runs on: engines go round-robin over the nodes, or each takes a run of them
+        std::vector<std::vector<size_t>> groups(engineCount);
+        size_t nodeCount = numaNodes.size();
+        for (size_t i = 0; i < engineCount; i++) {
+            if (engineCount >= nodeCount) {
+                groups[i].push_back(i % nodeCount);
+            }
+            else {
+                for (size_t n = i * nodeCount / engineCount; n < (i + 1) * nodeCount / engineCount; n++) groups[i].push_back(n);
+            }
+        }
+
+        std::vector<EngineResources> plan(engineCount);
+        std::vector<size_t> enginesOnNode(nodeCount, 0);
+        for (size_t i = 0; i < engineCount; i++) {
+            for (size_t n : groups[i]) enginesOnNode[n]++;
+        }
+
+        std::vector<size_t> placedOnNode(nodeCount, 0);
+        for (size_t i = 0; i < engineCount; i++) {
+            EngineResources& resources = plan[i];
+
+            uint64_t memoryMb = 0;
+            std::vector<int> cpus;
+            for (size_t n : groups[i]) {
+                memoryMb += numaNodes[n].memoryMb / enginesOnNode[n];
+                cpus.insert(cpus.end(), numaNodes[n].cpus.begin(), numaNodes[n].cpus.end());
+            }
+            resources.hashMb = autoHash ? static_cast<int>(std::clamp<uint64_t>(memoryMb / 2, 16, 1 << 20)) : hashPerEngine;
+
+            if (groups[i].size() > 1) {
+                resources.threads = threadsFor(std::max<size_t>(cpus.size(), 1));
+                if (pin) resources.cpus = std::move(cpus);
+                continue;
+            }
+
+            // The engines sharing a node split its CPUs into consecutive slices that differ by at most one;
+            // with more engines than CPUs, some slices are empty and those engines share the next CPU
+            size_t n = groups[i][0];
+            size_t nodeCpus = cpus.empty() ? machineCpus : cpus.size();
+            size_t slot = placedOnNode[n]++;
+            size_t sliceStart = slot * nodeCpus / enginesOnNode[n];
+            size_t sliceSize = (slot + 1) * nodeCpus / enginesOnNode[n] - sliceStart;
+            resources.threads = threadsFor(std::max<size_t>(sliceSize, 1));
+
+            if (!pin) continue;
+            resources.numaNode = numaNodes[n].id;
+            if (cpus.empty()) continue;
+            size_t pinned = std::clamp<size_t>(static_cast<size_t>(resources.threads), 1, std::max<size_t>(sliceSize, 1));
+            resources.cpus.assign(cpus.begin() + sliceStart, cpus.begin() + sliceStart + pinned);
+        }
+        return plan;
+    }
+
+    // The CPU list in kernel notation, e.g. "0-3,8", for log output.
+    static std::string formatCpuList(const std::vector<int>& cpus) {
+        std::string text;
+        for (size_t i = 0; i < cpus.size();) {
+            size_t j = i;
+            while (j + 1 < cpus.size() && cpus[j + 1] == cpus[j] + 1) j++;
+            if (!text.empty()) text += ',';
+            text += std::to_string(cpus[i]);
+            if (j > i) text += '-' + std::to_string(cpus[j]);
+            i = j + 1;
+        }
+        return text.empty() ? "any" : text;
+    }
+};
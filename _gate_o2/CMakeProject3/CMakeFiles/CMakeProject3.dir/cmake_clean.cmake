@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/CMakeProject3.dir/CMakeProject3.cpp.o"
+  "CMakeFiles/CMakeProject3.dir/CMakeProject3.cpp.o.d"
+  "CMakeProject3"
+  "CMakeProject3.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/CMakeProject3.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
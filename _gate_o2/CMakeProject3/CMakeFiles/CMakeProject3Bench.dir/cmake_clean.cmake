@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/CMakeProject3Bench.dir/Benchmark.cpp.o"
+  "CMakeFiles/CMakeProject3Bench.dir/Benchmark.cpp.o.d"
+  "CMakeProject3Bench"
+  "CMakeProject3Bench.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/CMakeProject3Bench.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
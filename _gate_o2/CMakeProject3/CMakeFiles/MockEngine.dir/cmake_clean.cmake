@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/MockEngine.dir/MockEngine.cpp.o"
+  "CMakeFiles/MockEngine.dir/MockEngine.cpp.o.d"
+  "MockEngine"
+  "MockEngine.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/MockEngine.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
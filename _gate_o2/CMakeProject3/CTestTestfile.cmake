@@ -0,0 +1,8 @@
+# CMake generated Testfile for 
+# Source directory: /root/repo/CMakeProject3
+# Build directory: /root/repo/_gate_o2/CMakeProject3
+# 
+# This file includes the relevant testing commands required for 
+# testing this directory and lists subdirectories to be tested as well.
+add_test(CMakeProject3Checks "/root/repo/_gate_o2/CMakeProject3/CMakeProject3Bench" "--check")
+set_tests_properties(CMakeProject3Checks PROPERTIES  _BACKTRACE_TRIPLES "/root/repo/CMakeProject3/CMakeLists.txt;42;add_test;/root/repo/CMakeProject3/CMakeLists.txt;0;")